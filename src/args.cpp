@@ -11,22 +11,47 @@ namespace flow
     args::args() : arg_parser_(
         "A simple power flow calculator using Newton's method.\n"
         "usage: arma-flow [--version] [-h | --help] [-o <output_file_prefix>]\n"
-        "                 -n <node_data_file> -e <edge_data_file> [-r]\n"
+        "                 -n <node_data_file> -e <edge_data_file> [-r] [--node-id]\n"
+        "                 [--convert <case_file>] | --case <case_file>\n"
+        "                 [--method <newton | polar | fdlf>] [--ordering <md | rcm | colamd>]\n"
+        "                 [--mixed-precision]\n"
         "                 [-i <max_iterations>] [-a <accuracy>] [-v | --verbose]\n"
-        "                 [-s <node_id>] [--ignore-load]\n"
-        "                 [--tr <transition_impedance(real)>] [--ti <transition_impedance(imag)>]",
+        "                 [-s <node_id> | -s <node_id>,... | -s all] [--ignore-load] [--node-impedance]\n"
+        "                 [--tr <transition_impedance(real)>,...] [--ti <transition_impedance(imag)>,...]\n"
+        "                 [--snapshots <snapshot_dir | snapshot_file>] [--switching <switching_file>]\n"
+        "                 [--contingency n-1] [--vmin <min_voltage>] [--vmax <max_voltage>]\n"
+        "                 [--serve <socket>]\n"
+        "                 [--outputs <flow | ybus | zbus | fault>,...] [--matrix-format <csv | mm | triplet>]\n"
+        "                 [--threads <num_threads>] [--profile]",
         "arma-flow version 0.0.1")
     {
         arg_parser_.newString("o", "result-");
         arg_parser_.newString("n");
         arg_parser_.newString("e");
         arg_parser_.newFlag("r");
+        arg_parser_.newFlag("node-id");
+        arg_parser_.newString("convert");
+        arg_parser_.newString("case");
+        arg_parser_.newString("method", "newton");
+        arg_parser_.newString("ordering", "colamd");
+        arg_parser_.newFlag("mixed-precision");
         arg_parser_.newInt("i", 100);
         arg_parser_.newDouble("a", 0.00001);
-        arg_parser_.newInt("s");
+        arg_parser_.newString("s");
         arg_parser_.newFlag("ignore-load");
-        arg_parser_.newDouble("tr", 0);
-        arg_parser_.newDouble("ti", 0);
+        arg_parser_.newFlag("node-impedance");
+        arg_parser_.newString("tr", "0");
+        arg_parser_.newString("ti", "0");
+        arg_parser_.newString("snapshots");
+        arg_parser_.newString("switching");
+        arg_parser_.newString("contingency");
+        arg_parser_.newDouble("vmin", 0.95);
+        arg_parser_.newDouble("vmax", 1.05);
+        arg_parser_.newString("serve");
+        arg_parser_.newString("outputs", "flow,ybus,fault");
+        arg_parser_.newString("matrix-format", "csv");
+        arg_parser_.newInt("threads", 0);
+        arg_parser_.newFlag("profile");
         arg_parser_.newFlag("verbose v");
     }
 
@@ -51,6 +76,40 @@ namespace flow
         return arg_parser_.getFlag("r");
     }
 
+    bool args::node_id()
+    {
+        return arg_parser_.getFlag("node-id");
+    }
+
+    bool args::convert(std::string& path)
+    {
+        path = arg_parser_.getString("convert");
+        return arg_parser_.found("convert");
+    }
+
+    bool args::case_file_path(std::string& path)
+    {
+        path = arg_parser_.getString("case");
+        return arg_parser_.found("case");
+    }
+
+    bool args::method(std::string& method)
+    {
+        method = arg_parser_.getString("method");
+        return arg_parser_.found("method");
+    }
+
+    bool args::ordering(std::string& ordering)
+    {
+        ordering = arg_parser_.getString("ordering");
+        return arg_parser_.found("ordering");
+    }
+
+    bool args::mixed_precision()
+    {
+        return arg_parser_.getFlag("mixed-precision");
+    }
+
     bool args::max_iterations(unsigned& max)
     {
         const auto arg_i = arg_parser_.getInt("i");
@@ -68,12 +127,17 @@ namespace flow
         return arg_parser_.found("a");
     }
 
-    bool args::short_circuit(unsigned& node)
+    bool args::short_circuit(std::vector<unsigned>& nodes, bool& all)
     {
         if (!arg_parser_.found("s")) {
             return false;
         }
-        node = arg_parser_.getInt("s");
+        const auto value = arg_parser_.getString("s");
+        nodes.clear();
+        all = value == "all";
+        if (!all && !parse_list(value, nodes)) {
+            nodes.clear();
+        }
         return true;
     }
 
@@ -82,15 +146,92 @@ namespace flow
         return arg_parser_.getFlag("ignore-load");
     }
 
-    bool args::transition_impedance(std::complex<double>& z_f)
+    bool args::node_impedance()
     {
-        if (!arg_parser_.found("tr") && !arg_parser_.found("ti")) {
+        return arg_parser_.getFlag("node-impedance");
+    }
+
+    bool args::transition_impedance(std::vector<std::complex<double>>& z_f)
+    {
+        z_f.clear();
+        const auto found = arg_parser_.found("tr") || arg_parser_.found("ti");
+        std::vector<double> real, imag;
+        if (!parse_list(arg_parser_.getString("tr"), real) || !parse_list(arg_parser_.getString("ti"), imag)) {
+            return found;
+        }
+        // Lists should be of the same length, unless one of them has only one element.
+        const auto size = std::max(real.size(), imag.size());
+        if ((real.size() != size && real.size() != 1) || (imag.size() != size && imag.size() != 1)) {
+            return found;
+        }
+        for (auto i = 0U; i < size; ++i) {
+            z_f.emplace_back(real[real.size() == 1 ? 0 : i], imag[imag.size() == 1 ? 0 : i]);
+        }
+        return found;
+    }
+
+    bool args::snapshots(std::string& path)
+    {
+        path = arg_parser_.getString("snapshots");
+        return arg_parser_.found("snapshots");
+    }
+
+    bool args::switching(std::string& path)
+    {
+        path = arg_parser_.getString("switching");
+        return arg_parser_.found("switching");
+    }
+
+    bool args::contingency(std::string& mode)
+    {
+        mode = arg_parser_.getString("contingency");
+        return arg_parser_.found("contingency");
+    }
+
+    bool args::voltage_limits(double& min, double& max)
+    {
+        min = arg_parser_.getDouble("vmin");
+        max = arg_parser_.getDouble("vmax");
+        return arg_parser_.found("vmin") || arg_parser_.found("vmax");
+    }
+
+    bool args::serve(std::string& path)
+    {
+        path = arg_parser_.getString("serve");
+        return arg_parser_.found("serve");
+    }
+
+    bool args::outputs(std::vector<std::string>& outputs)
+    {
+        outputs.clear();
+        if (!parse_list(arg_parser_.getString("outputs"), outputs)) {
+            outputs.clear();
+        }
+        return arg_parser_.found("outputs");
+    }
+
+    bool args::matrix_format(std::string& format)
+    {
+        format = arg_parser_.getString("matrix-format");
+        return arg_parser_.found("matrix-format");
+    }
+
+    bool args::threads(unsigned& threads)
+    {
+        const auto arg_threads = arg_parser_.getInt("threads");
+        if (!arg_parser_.found("threads") || arg_threads <= 0) {
+            threads = 0;
             return false;
         }
-        z_f = { arg_parser_.getDouble("tr"), arg_parser_.getDouble("ti") };
+        threads = arg_threads;
         return true;
     }
 
+    bool args::profile()
+    {
+        return arg_parser_.getFlag("profile");
+    }
+
     bool args::verbose()
     {
         return arg_parser_.getFlag("v");
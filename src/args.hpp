@@ -8,6 +8,8 @@
 
 #include <complex>
 #include <janus.h>
+#include <sstream>
+#include <vector>
 
 namespace flow
 {
@@ -17,6 +19,29 @@ namespace flow
         /// The argument parser.
         janus::ArgParser arg_parser_;
 
+        /**
+         * Parse a comma-separated list.
+         *
+         * @param str String to be parsed.
+         * @param list Parsed values.
+         * @return Whether string is a valid non-empty list.
+         */
+        template <typename T>
+        static bool parse_list(const std::string& str, std::vector<T>& list)
+        {
+            std::istringstream stream(str);
+            std::string item;
+            while (std::getline(stream, item, ',')) {
+                std::istringstream item_stream(item);
+                T value;
+                if (!(item_stream >> value) || !(item_stream >> std::ws).eof()) {
+                    return false;
+                }
+                list.push_back(value);
+            }
+            return !list.empty();
+        }
+
     public:
         /**
          * Constructor.
@@ -53,6 +78,48 @@ namespace flow
          */
         bool remove_first_line();
 
+        /**
+         * Check whether node IDs are given in the first column of node data file.
+         */
+        bool node_id();
+
+        /**
+         * Get path to binary case file to be converted from input CSV files.
+         *
+         * @param path Path to case file.
+         * @return Whether argument is provided.
+         */
+        bool convert(std::string& path);
+
+        /**
+         * Get path to binary case file to be used instead of input CSV files.
+         *
+         * @param path Path to case file.
+         * @return Whether argument is provided.
+         */
+        bool case_file_path(std::string& path);
+
+        /**
+         * Get method of power flow calculation.
+         *
+         * @param method Name of method.
+         * @return Whether argument is provided.
+         */
+        bool method(std::string& method);
+
+        /**
+         * Get method of fill-reducing ordering.
+         *
+         * @param ordering Name of method.
+         * @return Whether argument is provided.
+         */
+        bool ordering(std::string& ordering);
+
+        /**
+         * Check whether to factorize jacobian matrix in single precision, with iterative refinement.
+         */
+        bool mixed_precision();
+
         /**
          * Check max number of iterations before aborting calculation.
          * 
@@ -68,11 +135,13 @@ namespace flow
         bool accuracy(double& epsilon);
 
         /**
-         * Calculate three-phase short circuit on specified node.
+         * Calculate three-phase short circuit on specified nodes.
          * 
+         * @param nodes Node IDs (empty if invalid).
+         * @param all Whether to calculate on all nodes.
          * @return Whether argument is provided.
          */
-        bool short_circuit(unsigned& node);
+        bool short_circuit(std::vector<unsigned>& nodes, bool& all);
 
         /**
          * Check whether to ignore load current when calculating short circuit.
@@ -80,9 +149,88 @@ namespace flow
         bool ignore_load();
 
         /**
-         * Get transition impedance of three-phase short circuit.
+         * Check whether to write node impedance matrix to file.
+         */
+        bool node_impedance();
+
+        /**
+         * Get transition impedances of three-phase short circuit.
+         *
+         * @param z_f Transition impedances (empty if invalid).
+         * @return Whether argument is provided.
+         */
+        bool transition_impedance(std::vector<std::complex<double>>& z_f);
+
+        /**
+         * Get path to snapshots of node data for time series calculation.
+         *
+         * @param path Path to a directory of node data files, or a long-format CSV file.
+         * @return Whether argument is provided.
+         */
+        bool snapshots(std::string& path);
+
+        /**
+         * Get path to switching events of edges.
+         *
+         * @param path Path to a CSV file of switching events.
+         * @return Whether argument is provided.
+         */
+        bool switching(std::string& path);
+
+        /**
+         * Get contingency analysis mode.
+         *
+         * @param mode Contingency analysis mode (only "n-1" is supported).
+         * @return Whether argument is provided.
+         */
+        bool contingency(std::string& mode);
+
+        /**
+         * Get voltage limits for contingency analysis.
+         *
+         * @param min Lower limit of node voltage.
+         * @param max Upper limit of node voltage.
+         * @return Whether argument is provided.
+         */
+        bool voltage_limits(double& min, double& max);
+
+        /**
+         * Get path to Unix domain socket, on which requests are served after the base case converges.
+         *
+         * @param path Path to socket.
+         * @return Whether argument is provided.
+         */
+        bool serve(std::string& path);
+
+        /**
+         * Get names of outputs to be written.
+         *
+         * @param outputs Names of outputs (empty if invalid).
+         * @return Whether argument is provided.
+         */
+        bool outputs(std::vector<std::string>& outputs);
+
+        /**
+         * Get format of network matrices (node admittance matrix and node impedance matrix).
+         *
+         * @param format Name of format.
+         * @return Whether argument is provided.
+         */
+        bool matrix_format(std::string& format);
+
+        /**
+         * Get number of threads.
+         *
+         * @return Whether argument is provided.
+         */
+        bool threads(unsigned& threads);
+
+        /**
+         * Check whether to write a profiling report.
+         *
+         * @return Whether argument is provided.
          */
-        bool transition_impedance(std::complex<double>& z_f);
+        bool profile();
 
         /**
          * Check whether to enable verbose output.
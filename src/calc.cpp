@@ -5,101 +5,191 @@
 //
 
 #include "calc.hpp"
-#include "writer.hpp"
+#include "calc_error.hpp"
+#include "parallel.hpp"
+#include "profiler.hpp"
+#include "printer.hpp"
 
 namespace flow
 {
-    unsigned calc::node_offset(unsigned id) const
+    namespace
     {
-        for (auto offset = 0U; offset < num_nodes_; ++offset) {
-            if (nodes_[offset].id == id) {
-                return offset;
+        /**
+         * Print size, fill-in and number of floating-point operations of a factorized matrix,
+         * if symbolic analysis is not reused.
+         *
+         * @param name Name of matrix.
+         * @param lu Factorization of matrix.
+         */
+        template <typename T>
+        void print_factors(const char* name, const lu<T>& lu)
+        {
+            if (!lu.reused()) {
+                printer::println(name, " factorized with ", lu.nnz(), " non-zero elements, ",
+                    lu.nnz_factors(), " in factors, and ", lu.flops(), " flops.");
             }
         }
-        return 0;
-    }
 
-    double calc::j_elem_g_b(unsigned row, unsigned col) const
-    {
-        return n_adm_g_.at(row, col) * e_[row] + n_adm_b_.at(row, col) * f_[row];
+        /**
+         * Add size, fill-in and number of floating-point operations of a factorized matrix
+         * to profiling report.
+         *
+         * @param name Name of matrix.
+         * @param lu Factorization of matrix.
+         */
+        template <typename T>
+        void profile_factors(const std::string& name, const lu<T>& lu)
+        {
+            if (!lu.nnz()) {
+                return;
+            }
+            profiler::info(name + "_nnz", lu.nnz());
+            profiler::info(name + "_fill", static_cast<double>(lu.nnz_factors()) - lu.nnz());
+            profiler::info(name + "_flops", lu.flops());
+        }
     }
 
-    double calc::j_elem_b_g(unsigned row, unsigned col) const
+    bool calc::find_node(unsigned id, unsigned& offset) const
     {
-        return n_adm_b_.at(row, col) * e_[row] - n_adm_g_.at(row, col) * f_[row];
+        if (!explicit_id_) {
+            offset = id - 1;
+            return id >= 1 && id <= num_nodes_;
+        }
+        const auto iter = id_offsets_.find(id);
+        if (iter == id_offsets_.end()) {
+            return false;
+        }
+        offset = iter->second;
+        return true;
     }
 
-    double calc::j_elem_a(unsigned row) const
+    void calc::jacobian_pattern()
     {
-        auto sum = 0.0;
-        for (auto col = 0U; col < num_nodes_; ++col) {
-            if (row == col || adj_.at(row, col)) {
-                sum += n_adm_b_.at(row, col) * f_[col] - n_adm_g_.at(row, col) * e_[col];
+        // In rectangular coordinates, row 2i and column 2i of jacobian matrix corresponds
+        // to P(i) and f(i), while row 2i + 1 and column 2i + 1 corresponds to Q(i) or U(i)^2
+        // and e(i). Element Y(i, j) of node admittance matrix yields a 2x2 block at (2i, 2j),
+        // except that the second row of the block is non-zero only if i == j for PV nodes.
+        // In polar coordinates, the variables are theta(i) and U(i), while the equations are
+        // P(i) and Q(i), and PV nodes have neither U(i) nor Q(i).
+        const auto polar_coord = method_ == polar;
+        j_size_ = polar_coord ? num_pq_ + num_nodes_ - 1 : 2 * num_nodes_ - 2;
+        const auto absent = n_adm_.n_nonzero * 4;
+        std::vector<arma::uword> row_indices;
+        j_col_ptrs_.zeros(j_size_ + 1);
+        j_scatter_.set_size(4, n_adm_.n_nonzero);
+        j_scatter_.fill(absent);
+        for (auto n = 0U; n < num_nodes_ - 1; ++n) {
+            for (auto var = 0U; var < 2; ++var) {
+                if (var && polar_coord && n >= num_pq_) {
+                    continue;
+                }
+                for (auto k = n_adm_.col_ptrs[n]; k < n_adm_.col_ptrs[n + 1]; ++k) {
+                    const auto m = n_adm_.row_indices[k];
+                    // Swing node is excluded.
+                    if (m == num_nodes_ - 1) {
+                        continue;
+                    }
+                    j_scatter_.at(var, k) = row_indices.size();
+                    row_indices.push_back(j_offset_p(m));
+                    if (m < num_pq_ || (!polar_coord && m == n)) {
+                        j_scatter_.at(2 + var, k) = row_indices.size();
+                        row_indices.push_back(j_offset_q(m));
+                    }
+                }
+                j_col_ptrs_[(var ? j_offset_q(n) : j_offset_p(n)) + 1] = row_indices.size();
             }
         }
-        return sum;
-    }
-
-    double calc::j_elem_c(unsigned row) const
-    {
-        auto sum = 0.0;
-        for (auto col = 0U; col < num_nodes_; ++col) {
-            if (row == col || adj_.at(row, col)) {
-                sum += n_adm_g_.at(row, col) * f_[col] + n_adm_b_.at(row, col) * e_[col];
+        j_row_indices_ = arma::uvec(row_indices);
+        j_values_.zeros(row_indices.size());
+        // Both variables of a node are eliminated together, in elimination order of nodes.
+        std::vector<unsigned> order;
+        for (auto&& node : elimination_order(num_nodes_ - 1)) {
+            order.push_back(j_offset_p(node));
+            if (!polar_coord || node < num_pq_) {
+                order.push_back(j_offset_q(node));
             }
         }
-        return sum;
+        // Jacobian matrix is not symmetric in value (and rows of PV nodes in rectangular
+        // coordinates only have a few elements), so that rows are still partially pivoted.
+        j_lu_.set_ordering(order, false);
+        j_lu_single_.set_ordering(order, false);
     }
 
     void calc::jacobian()
     {
-        mat_elem_foreach(j_h_, [this](auto& elem, auto row, auto col)
+        // Only elements in the sparsity pattern are updated. Elements of each column of
+        // node admittance matrix are scattered to distinct locations.
+        node_foreach([this](unsigned col)
         {
-            if (row == col) {
-                elem = j_elem_c(row) - j_elem_d(row);
-            } else {
-                elem = -j_elem_b_g(row, col);
+            if (col == num_nodes_ - 1) {
+                return;
             }
-        });
-        mat_elem_foreach(j_n_, [this](auto& elem, auto row, auto col)
-        {
-            if (row == col) {
-                elem = -j_elem_a(row) + j_elem_b(row);
-            } else {
-                elem = j_elem_g_b(row, col);
-            }
-        });
-        mat_elem_foreach(j_m_, [this](auto& elem, auto row, auto col)
-        {
-            if (row == col) {
-                elem = -j_elem_a(row) - j_elem_b(row);
-            } else {
-                elem = -j_elem_g_b(row, col);
-            }
-        });
-        mat_elem_foreach(j_l_, [this](auto& elem, auto row, auto col)
-        {
-            if (row == col) {
-                elem = -j_elem_c(row) - j_elem_d(row);
-            } else {
-                elem = -j_elem_b_g(row, col);
+            for (auto k = n_adm_.col_ptrs[col]; k < n_adm_.col_ptrs[col + 1]; ++k) {
+                const auto row = n_adm_.row_indices[k];
+                if (row == num_nodes_ - 1) {
+                    continue;
+                }
+                const std::complex<double> y = n_adm_.values[k];
+                auto& h = j_values_[j_scatter_.at(0, k)];
+                auto& n = j_values_[j_scatter_.at(1, k)];
+                if (row == col) {
+                    const auto a = j_elem_a(row), b = j_elem_g_b(y, row);
+                    const auto c = j_elem_c(row), d = j_elem_b_g(y, row);
+                    h = c - d;
+                    n = -a + b;
+                    if (row < num_pq_) {
+                        j_values_[j_scatter_.at(2, k)] = -a - b;
+                        j_values_[j_scatter_.at(3, k)] = -c - d;
+                    } else {
+                        j_values_[j_scatter_.at(2, k)] = f_[row] * 2;
+                        j_values_[j_scatter_.at(3, k)] = e_[row] * 2;
+                    }
+                } else {
+                    h = -j_elem_b_g(y, row);
+                    n = j_elem_g_b(y, row);
+                    if (row < num_pq_) {
+                        j_values_[j_scatter_.at(2, k)] = -j_elem_g_b(y, row);
+                        j_values_[j_scatter_.at(3, k)] = -j_elem_b_g(y, row);
+                    }
+                }
             }
         });
-        // We shouldn't start at 0. We should start at m.
-        mat_elem_foreach(j_r_, [this](auto& elem, auto row, auto col)
+    }
+
+    void calc::jacobian_polar()
+    {
+        // With current injection I = Y * U and S = U * conj(I):
+        // dS(i) / dtheta(j) = j * U(i) * conj(I(i) * [i == j] - Y(i, j) * U(j)),
+        // dS(i) / d|U(j)| = U(i) * conj(Y(i, j) * U(j) / |U(j)|) + conj(I(i)) * U(i) / |U(i)| * [i == j].
+        node_foreach([this](unsigned col)
         {
-            if (row + num_pq_ == col) {
-                elem = f_[row + num_pq_] * 2;
-            } else {
-                elem = 0;
+            if (col == num_nodes_ - 1) {
+                return;
             }
-        });
-        mat_elem_foreach(j_s_, [this](auto& elem, auto row, auto col)
-        {
-            if (row + num_pq_ == col) {
-                elem = e_[row + num_pq_] * 2;
-            } else {
-                elem = 0;
+            const std::complex<double> u_col(e_[col], f_[col]);
+            for (auto k = n_adm_.col_ptrs[col]; k < n_adm_.col_ptrs[col + 1]; ++k) {
+                const auto row = n_adm_.row_indices[k];
+                if (row == num_nodes_ - 1) {
+                    continue;
+                }
+                const std::complex<double> y = n_adm_.values[k];
+                const std::complex<double> u_row(e_[row], f_[row]);
+                auto d_theta = std::complex<double>(0, 1) * u_row * std::conj(-y * u_col);
+                auto d_u = u_row * std::conj(y * u_col / std::abs(u_col));
+                if (row == col) {
+                    d_theta += std::complex<double>(0, 1) * u_row * std::conj(i_[row]);
+                    d_u += std::conj(i_[row]) * u_row / std::abs(u_row);
+                }
+                j_values_[j_scatter_.at(0, k)] = d_theta.real();
+                if (col < num_pq_) {
+                    j_values_[j_scatter_.at(1, k)] = d_u.real();
+                }
+                if (row < num_pq_) {
+                    j_values_[j_scatter_.at(2, k)] = d_theta.imag();
+                    if (col < num_pq_) {
+                        j_values_[j_scatter_.at(3, k)] = d_u.imag();
+                    }
+                }
             }
         });
     }
@@ -107,241 +197,578 @@ namespace flow
     void calc::init(
         const arma::mat&            nodes,
         const arma::mat&            edges,
+        bool                        explicit_id,
+        method_type                 method,
         bool                        verbose, 
         double                      epsilon, 
         bool                        short_circuit, 
         bool                        ignore_load,
-        unsigned                    short_circuit_node, 
-        const std::complex<double>& z_f)
+        const std::vector<unsigned>&              short_circuit_nodes,
+        const std::vector<std::complex<double>>&  z_f)
     {
-        if (nodes.n_cols != (short_circuit ? 6 : 5) || edges.n_cols != 6) {
-            writer::error("Bad input matrix format.");
+        // Node ID (if given) comes before other columns.
+        const auto id_cols = explicit_id ? 1U : 0U;
+        if (nodes.n_cols != (short_circuit ? 6 : 5) + id_cols || edges.n_cols != 6) {
+            throw calc_error("Bad input matrix format.");
         }
         short_circuit_ = short_circuit;
-        nodes.each_row([this](const arma::rowvec& row)
+        explicit_id_ = explicit_id;
+        // Node type of each row, which is 0 for PQ nodes, 1 for PV nodes and 2 for swing node.
+        std::vector<unsigned> types;
+        types.reserve(nodes.n_rows);
+        node_ids_.reserve(nodes.n_rows);
+        nodes.each_row([id_cols, &types, this](const arma::rowvec& row)
         {
-            const auto type_val = static_cast<unsigned>(row[short_circuit_ ? 5 : 4]);
-            auto type = node_data::swing;
+            const auto type_val = static_cast<unsigned>(row[id_cols + (short_circuit_ ? 5 : 4)]);
             if (type_val == 1) {
-                type = node_data::pq;
+                types.push_back(0);
                 ++num_pq_;
             } else if (type_val == 2) {
-                type = node_data::pv;
+                types.push_back(1);
                 ++num_pv_;
-            } else if (type_val != 0) {
-                writer::error("Bad node type.");
+            } else if (type_val == 0) {
+                types.push_back(2);
+            } else {
+                throw calc_error("Bad node type.");
             }
-            if (short_circuit_) {
-                nodes_.push_back({
-                    num_nodes_++, row[0], row[1], row[2], row[3], row[4], type
-                });
+            if (explicit_id_) {
+                const auto id = static_cast<unsigned>(row[0]);
+                if (!id_offsets_.emplace(id, num_nodes_).second) {
+                    throw calc_error("Duplicate node ID " + std::to_string(id) + ".");
+                }
+                node_ids_.push_back(id);
             } else {
-                nodes_.push_back({
-                    num_nodes_++, row[0], row[1], row[2], row[3], 0, type
-                });
+                node_ids_.push_back(num_nodes_ + 1);
             }
+            ++num_nodes_;
         });
+        if (num_nodes_ != num_pq_ + num_pv_ + 1) {
+            throw calc_error("Only one swing node should exist.");
+        }
         // Nodes should be sorted, PQ nodes should be followed by PV nodes,
         // while swing node be the last.
-        std::sort(nodes_.begin(), nodes_.end(), [](auto&& n1, auto&& n2)
-        {
-            return n1.type < n2.type;
-        });
-        adj_.zeros(num_nodes_, num_nodes_);
-        if (num_nodes_ != num_pq_ + num_pv_ + 1) {
-            writer::error("Only one swing node should exist.");
+        unsigned next[] = { 0, num_pq_, num_pq_ + num_pv_ };
+        nodes_.id.resize(num_nodes_);
+        node_offsets_.resize(num_nodes_);
+        for (auto offset = 0U; offset < num_nodes_; ++offset) {
+            const auto row = next[types[offset]]++;
+            nodes_.id[row] = offset;
+            node_offsets_[offset] = row;
         }
-        edges.each_row([this](const arma::rowvec& row)
+        // Columns are gathered one at a time.
+        const auto sorted_col = [&nodes, this](unsigned col)
         {
-            const auto n1 = static_cast<unsigned>(row[0]) - 1;
-            const auto n2 = static_cast<unsigned>(row[1]) - 1;
-            if (n1 >= num_nodes_ || n2 >= num_nodes_) {
-                writer::error("Bad node offset.");
+            arma::colvec retval(num_nodes_);
+            for (auto row = 0U; row < num_nodes_; ++row) {
+                retval[row] = nodes.at(nodes_.id[row], col);
             }
-            edges_.push_back({
-                n1, n2, row[2], row[3], row[4], row[5]
-            });
-        });
+            return retval;
+        };
+        nodes_.v = sorted_col(id_cols);
+        nodes_.g = sorted_col(id_cols + 1);
+        nodes_.p = sorted_col(id_cols + 2);
+        nodes_.q = sorted_col(id_cols + 3);
+        if (short_circuit_) {
+            nodes_.x_d = sorted_col(id_cols + 4);
+        } else {
+            nodes_.x_d.zeros(num_nodes_);
+        }
+        const auto n_edges = static_cast<unsigned>(edges.n_rows);
+        edges_.m.resize(n_edges);
+        edges_.n.resize(n_edges);
+        for (auto edge = 0U; edge < n_edges; ++edge) {
+            if (!find_node(static_cast<unsigned>(edges.at(edge, 0)), edges_.m[edge]) ||
+                !find_node(static_cast<unsigned>(edges.at(edge, 1)), edges_.n[edge])) {
+                throw calc_error("Bad node ID in edge data.");
+            }
+        }
+        edges_.r = edges.col(2);
+        edges_.x = edges.col(3);
+        edges_.b = edges.col(4);
+        edges_.k = edges.col(5);
+        edges_.in_service.assign(n_edges, true);
+        edges_.y_re.set_size(n_edges);
+        edges_.y_im.set_size(n_edges);
+        edges_.shunt.set_size(n_edges);
+        edges_.tap_nn.set_size(n_edges);
+        edges_.tap_mn.set_size(n_edges);
+        edge_factors(0, n_edges);
+        method_ = method;
         verbose_ = verbose;
         epsilon_ = epsilon;
         ignore_load_ = ignore_load;
         if (short_circuit_) {
-            if (short_circuit_node < 1 || short_circuit_node > num_nodes_) {
-                writer::error("Bad node ID for short circuit calculation.");
+            // Calculate on all nodes if not specified.
+            if (short_circuit_nodes.empty()) {
+                for (auto offset = 0U; offset < num_nodes_; ++offset) {
+                    short_circuit_nodes_.push_back(node_offset(offset));
+                }
+            }
+            for (auto&& id : short_circuit_nodes) {
+                unsigned offset;
+                if (!find_node(id, offset)) {
+                    throw calc_error("Bad node ID for short circuit calculation.");
+                }
+                short_circuit_nodes_.push_back(node_offset(offset));
             }
-            short_circuit_node_ = node_offset(short_circuit_node - 1);
-            z_f_ = z_f;
+            if (z_f.empty()) {
+                throw calc_error("Bad transition impedance.");
+            }
+            short_circuit_node_ = short_circuit_nodes_.front();
+            z_fs_ = z_f;
+            z_f_ = z_fs_.front();
         }
     }
 
-    std::pair<arma::mat, arma::mat> calc::node_admittance()
+    void calc::edge_factors(unsigned first, unsigned last)
     {
-        n_adm_.zeros(num_nodes_, num_nodes_);
-        n_adm_orig_.zeros(num_nodes_, num_nodes_);
-        for (auto&& edge : edges_) {
-            const auto admittance = edge.admittance();
-            const auto m = node_offset(edge.m);
-            const auto n = node_offset(edge.n);
-            // Whether this edge has transformer.
-            if (edge.k) {
-                n_adm_.at(m, m) = n_adm_orig_.at(edge.m, edge.m) += admittance;
-                n_adm_.at(n, n) = n_adm_orig_.at(edge.n, edge.n) += admittance / std::pow(edge.k, 2);
-                n_adm_.at(m, n) = n_adm_orig_.at(edge.m, edge.n) -= admittance / edge.k;
-                n_adm_.at(n, m) = n_adm_orig_.at(edge.n, edge.m) -= admittance / edge.k;
-            } else {
-                const auto delta_diag = admittance + edge.grounding_admittance();
-                n_adm_.at(m, m) = n_adm_orig_.at(edge.m, edge.m) += delta_diag;
-                n_adm_.at(n, n) = n_adm_orig_.at(edge.n, edge.n) += delta_diag;
-                n_adm_.at(m, n) = n_adm_orig_.at(edge.m, edge.n) -= admittance;
-                n_adm_.at(n, m) = n_adm_orig_.at(edge.n, edge.m) -= admittance;
-            }
-            adj_.at(m, n) = 1;
-            adj_.at(n, m) = 1;
-        }
-        n_adm_g_ = arma::real(n_adm_);
-        n_adm_b_ = arma::imag(n_adm_);
-        const auto n_adm_orig_g = arma::real(n_adm_orig_);
-        const auto n_adm_orig_b = arma::imag(n_adm_orig_);
-        if (verbose_) {
-            writer::println("Real part of node admittance matrix:");
-            writer::print_mat(n_adm_orig_g);
-            writer::println("Imaginary part of node admittance matrix:");
-            writer::print_mat(n_adm_orig_b);
+        const auto r = edges_.r.memptr(), x = edges_.x.memptr(), b = edges_.b.memptr(), k = edges_.k.memptr();
+        const auto y_re = edges_.y_re.memptr(), y_im = edges_.y_im.memptr(), shunt = edges_.shunt.memptr();
+        const auto tap_nn = edges_.tap_nn.memptr(), tap_mn = edges_.tap_mn.memptr();
+        for (auto i = first; i < last; ++i) {
+            const auto deno = r[i] * r[i] + x[i] * x[i];
+            y_re[i] = r[i] / deno;
+            y_im[i] = -x[i] / deno;
+        }
+        // Grounding admittance is ignored for transformers (where k is non-zero).
+        for (auto i = first; i < last; ++i) {
+            const auto is_transformer = k[i] != 0;
+            const auto tap = is_transformer ? 1 / k[i] : 1.0;
+            shunt[i] = is_transformer ? 0 : b[i];
+            tap_nn[i] = tap * tap;
+            tap_mn[i] = tap;
         }
-        return { n_adm_orig_g, n_adm_orig_b };
     }
 
-    std::pair<arma::mat, arma::mat> calc::node_impedance()
+    void calc::build_node_admittance()
     {
-        n_imp_.zeros(num_nodes_, num_nodes_);
-        auto adm = n_adm_, adm_orig = n_adm_orig_;
+        // Each edge contributes a 2x2 block, and each node a (possibly empty) diagonal
+        // element, so that the sparsity pattern always covers the diagonal.
+        arma::umat locations(2, 4 * num_edges() + num_nodes_);
+        arma::cx_colvec values(locations.n_cols);
         auto i = 0U;
-        for (auto&& node : nodes_) {
-            if (node.type == node_data::pq) {
-                if (!ignore_load_) {
-                    // Note that we should use P(LD) and Q(LD).
-                    const auto impedance = std::complex<double>(-init_p_[i], init_q_[i]) / std::pow(v_[i], 2);
-                    adm.at(i, i) = adm_orig.at(node.id, node.id) += impedance;
+        const auto add = [&locations, &values, &i](unsigned row, unsigned col, std::complex<double> val)
+        {
+            locations.at(0, i) = row;
+            locations.at(1, i) = col;
+            values[i++] = val;
+        };
+        for (auto node = 0U; node < num_nodes_; ++node) {
+            add(node, node, 0);
+        }
+        for (auto edge = 0U; edge < num_edges(); ++edge) {
+            const auto stamp = edge_stamp(edge);
+            const auto m = node_offset(edges_.m[edge]);
+            const auto n = node_offset(edges_.n[edge]);
+            add(m, m, stamp[0]);
+            add(n, n, stamp[1]);
+            add(m, n, stamp[2]);
+            add(n, m, stamp[2]);
+        }
+        // Duplicated locations are summed up. Zeros are kept, so that the sparsity
+        // pattern only depends on network topology.
+        n_adm_ = arma::sp_cx_mat(true, locations, values, num_nodes_, num_nodes_, true, false);
+    }
+
+    bool calc::set_node_admittance(const arma::uvec& order, arma::sp_cx_mat&& n_adm)
+    {
+        if (order.n_elem != num_nodes_ || n_adm.n_rows != num_nodes_ || n_adm.n_cols != num_nodes_) {
+            return false;
+        }
+        for (auto node = 0U; node < num_nodes_; ++node) {
+            if (order[node] != nodes_.id[node]) {
+                return false;
+            }
+        }
+        // Elements are later located by offset (see n_adm_offset()), so that the pattern should
+        // cover the diagonal and both elements of each edge, and be symmetric.
+        const auto has_element = [&n_adm](arma::uword row, arma::uword col)
+        {
+            const auto begin = n_adm.row_indices + n_adm.col_ptrs[col];
+            const auto end = n_adm.row_indices + n_adm.col_ptrs[col + 1];
+            return std::binary_search(begin, end, row);
+        };
+        for (auto col = 0U; col < num_nodes_; ++col) {
+            if (!has_element(col, col)) {
+                return false;
+            }
+            for (auto k = n_adm.col_ptrs[col]; k < n_adm.col_ptrs[col + 1]; ++k) {
+                if (!has_element(col, n_adm.row_indices[k])) {
+                    return false;
                 }
-            } else {
-                adm.at(i, i) = adm_orig.at(node.id, node.id) -= std::complex<double>(0, 1 / node.x_d);
             }
-            ++i;
         }
-        n_imp_ = adm.i();
-        n_imp_g_ = arma::real(n_imp_);
-        n_imp_b_ = arma::imag(n_imp_);
-        const auto imp_orig = adm_orig.i();
-        const auto n_imp_orig_g = arma::real(imp_orig);
-        const auto n_imp_orig_b = arma::imag(imp_orig);
+        for (auto edge = 0U; edge < num_edges(); ++edge) {
+            if (!has_element(node_offset(edges_.m[edge]), node_offset(edges_.n[edge]))) {
+                return false;
+            }
+        }
+        n_adm_ = std::move(n_adm);
+        n_adm_preset_ = true;
+        return true;
+    }
+
+    arma::uvec calc::node_order() const
+    {
+        arma::uvec order(num_nodes_);
+        vec_elem_foreach(order, [this](auto& elem, auto row)
+        {
+            elem = nodes_.id[row];
+        });
+        return order;
+    }
+
+    void calc::admittance_init()
+    {
+        if (!n_adm_preset_) {
+            build_node_admittance();
+        }
+        split_node_admittance();
+        partition_nodes();
+        {
+            profiler::scope timer("ordering");
+            elimination_order_ = ordering::compute(ordering_, num_nodes_, n_adm_.col_ptrs, n_adm_.row_indices);
+        }
+        y_f_lu_.set_ordering(elimination_order_, true);
+    }
+
+    std::vector<unsigned> calc::elimination_order(unsigned size) const
+    {
+        std::vector<unsigned> retval;
+        retval.reserve(elimination_order_.empty() ? 0 : size);
+        for (auto&& node : elimination_order_) {
+            if (node < size) {
+                retval.push_back(node);
+            }
+        }
+        return retval;
+    }
+
+    void calc::profile_factors() const
+    {
+        if (mixed_precision_ && j_lu_single_.nnz()) {
+            flow::profile_factors("jacobian", j_lu_single_);
+            profiler::info("jacobian_refinements", n_refine_);
+        } else {
+            flow::profile_factors("jacobian", j_lu_);
+        }
+        flow::profile_factors("b1", b1_lu_);
+        flow::profile_factors("b2", b2_lu_);
+        flow::profile_factors("ybus", y_f_lu_);
+    }
+
+    void calc::split_node_admittance()
+    {
+        n_adm_ptrs_.assign(n_adm_.col_ptrs, n_adm_.col_ptrs + num_nodes_ + 1);
+        n_adm_indices_.assign(n_adm_.row_indices, n_adm_.row_indices + n_adm_.n_nonzero);
+        n_adm_g_.resize(n_adm_.n_nonzero);
+        n_adm_b_.resize(n_adm_.n_nonzero);
+        for (auto k = 0U; k < n_adm_.n_nonzero; ++k) {
+            const std::complex<double> y = n_adm_.values[k];
+            n_adm_g_[k] = y.real();
+            n_adm_b_[k] = y.imag();
+        }
+    }
+
+    void calc::set_threads(unsigned threads)
+    {
+        threads_ = threads;
+        partition_nodes();
+    }
+
+    void calc::partition_nodes()
+    {
+        if (n_adm_.n_cols != num_nodes_) {
+            return;
+        }
+        const auto parts = std::min(parallel::threads(threads_),
+            std::max(static_cast<unsigned>(n_adm_.n_nonzero / min_nonzeros_per_thread), 1U));
+        node_ranges_ = parallel::partition(n_adm_.col_ptrs, num_nodes_, parts);
+        pool_.resize(node_ranges_.size() - 1);
+    }
+
+    arma::sp_cx_mat calc::node_admittance() const
+    {
+        auto n_adm_orig = to_orig_order(n_adm_);
         if (verbose_) {
-            writer::println("Real part of node impedance matrix:");
-            writer::print_mat(n_imp_orig_g);
-            writer::println("Imaginary part of node impedance matrix:");
-            writer::print_mat(n_imp_orig_b);
+            printer::println("Real part of node admittance matrix:");
+            printer::print_mat(arma::sp_mat(arma::real(n_adm_orig)));
+            printer::println("Imaginary part of node admittance matrix:");
+            printer::print_mat(arma::sp_mat(arma::imag(n_adm_orig)));
         }
-        return { n_imp_orig_g, n_imp_orig_b };
+        return n_adm_orig;
     }
 
-    void calc::iterate_init()
+    arma::cx_mat calc::node_impedance()
+    {
+        // Node impedance matrix is solved block by block with the existing factorization.
+        // Inverse of a symmetrically permuted matrix is the permuted inverse.
+        arma::cx_mat n_imp_orig(num_nodes_, num_nodes_);
+        const auto block_size = 64U;
+        arma::cx_mat block;
+        for (auto first = 0U; first < num_nodes_; first += block_size) {
+            const auto n_cols = std::min(block_size, num_nodes_ - first);
+            block.zeros(num_nodes_, n_cols);
+            for (auto col = 0U; col < n_cols; ++col) {
+                block.at(first + col, col) = 1;
+            }
+            if (!y_f_lu_.solve(block)) {
+                throw calc_error("Failed to solve node impedance matrix.");
+            }
+            mat_elem_foreach(block, [&n_imp_orig, first, this](auto&& elem, auto row, auto col)
+            {
+                n_imp_orig.at(nodes_.id[row], nodes_.id[first + col]) = elem;
+            });
+        }
+        if (verbose_) {
+            printer::println("Real part of node impedance matrix:");
+            printer::print_mat(arma::mat(arma::real(n_imp_orig)));
+            printer::println("Imaginary part of node impedance matrix:");
+            printer::print_mat(arma::mat(arma::imag(n_imp_orig)));
+        }
+        return n_imp_orig;
+    }
+
+    void calc::init_injections()
     {
         init_p_.zeros(num_nodes_ - 1);
         init_q_.zeros(num_pq_);
         init_v_.zeros(num_pv_);
-        auto i_p = 0;
-        auto i_q = 0;
-        auto i_v = 0;
-        e_.set_size(num_nodes_);
-        for (auto&& node : nodes_) {
-            if (node.type == node_data::pq) {
-                init_p_[i_p] = -node.p;
-                init_q_[i_q++] = -node.q;
-            } else if (node.type == node_data::pv) {
-                init_p_[i_p] = node.g - node.p;
-                init_v_[i_v++] = node.v;
-            }
-            e_[i_p++] = node.v;
+        for (auto row = 0U; row < num_pq_; ++row) {
+            init_p_[row] = -nodes_.p[row];
+            init_q_[row] = -nodes_.q[row];
         }
+        for (auto row = num_pq_; row < num_nodes_ - 1; ++row) {
+            init_p_[row] = nodes_.g[row] - nodes_.p[row];
+            init_v_[row - num_pq_] = nodes_.v[row];
+        }
+    }
+
+    void calc::iterate_init()
+    {
+        init_injections();
+        n_iter_ = 1;
+        e_ = nodes_.v;
         f_.zeros(num_nodes_);
-        j_h_.zeros(num_nodes_ - 1, num_nodes_ - 1);
-        j_n_.zeros(num_nodes_ - 1, num_nodes_ - 1);
-        j_m_.zeros(num_pq_, num_nodes_ - 1);
-        j_l_.zeros(num_pq_, num_nodes_ - 1);
-        j_r_.zeros(num_pv_, num_nodes_ - 1);
-        j_s_.zeros(num_pv_, num_nodes_ - 1);
+        if (method_ == fdlf) {
+            if (!fdlf_init()) {
+                throw calc_error("Matrix B' or B'' is singular.");
+            }
+        } else {
+            jacobian_pattern();
+        }
         delta_p_.zeros(num_nodes_ - 1);
         delta_q_.zeros(num_pq_);
         delta_v_.zeros(num_pv_);
         p_.zeros(num_nodes_);
         q_.zeros(num_nodes_);
+        i_.zeros(num_nodes_);
         update_f_x();
     }
 
-    void calc::prepare_solve()
+    void calc::update_node(unsigned id, double v, double g, double p, double q)
+    {
+        unsigned offset;
+        if (!find_node(id, offset)) {
+            throw calc_error("Bad node ID in snapshot data.");
+        }
+        const auto row = node_offset(offset);
+        nodes_.v[row] = v;
+        nodes_.g[row] = g;
+        nodes_.p[row] = p;
+        nodes_.q[row] = q;
+    }
+
+    void calc::snapshot_init()
+    {
+        init_injections();
+        // Voltage of PV nodes and swing node is scaled to the new set point, keeping phase angle.
+        for (auto row = num_pq_; row < num_nodes_; ++row) {
+            const auto u = std::abs(std::complex<double>(e_[row], f_[row]));
+            if (u > 0) {
+                e_[row] *= nodes_.v[row] / u;
+                f_[row] *= nodes_.v[row] / u;
+            } else {
+                e_[row] = nodes_.v[row];
+            }
+        }
+        // Copies of a calculation (see reset()) share symbolic analysis, but not factors.
+        if (method_ == fdlf && (!b1_lu_.factorized() || b1_lu_.rank() || b2_lu_.rank()) && !fdlf_init()) {
+            throw calc_error("Matrix B' or B'' is singular.");
+        }
+        n_iter_ = 1;
+        update_f_x();
+    }
+
+    bool calc::prepare_solve()
     {
         // Cross-construct F(x) vector.
-        f_x_.zeros(2 * num_nodes_ - 2);
+        f_x_.zeros(j_size_);
         for (auto row = 0U; row < num_nodes_ - 1; ++row) {
-            f_x_[2 * row] = delta_p_[row];
-            f_x_[2 * row + 1] = row < num_pq_ ? delta_q_[row] : delta_v_[row - num_pq_];
-        }
-        // Cross-construct jacobian matrix.
-        arma::mat jacobian(2 * num_nodes_ - 2, 2 * num_nodes_ - 2);
-        for (auto row = 0U; row < num_nodes_ - 1; ++row)
-            for (auto col = 0U; col < num_nodes_ - 1; ++col) {
-                jacobian.at(2 * row, 2 * col) = j_h_.at(row, col);
-                jacobian.at(2 * row, 2 * col + 1) = j_n_.at(row, col);
-                if (row < num_pq_) {
-                    jacobian.at(2 * row + 1, 2 * col) = j_m_.at(row, col);
-                    jacobian.at(2 * row + 1, 2 * col + 1) = j_l_.at(row, col);
-                } else {
-                    jacobian.at(2 * row + 1, 2 * col) = j_r_.at(row - num_pq_, col);
-                    jacobian.at(2 * row + 1, 2 * col + 1) = j_s_.at(row - num_pq_, col);
-                }
+            f_x_[j_offset_p(row)] = delta_p_[row];
+            if (row < num_pq_) {
+                f_x_[j_offset_q(row)] = delta_q_[row];
+            } else if (method_ != polar) {
+                f_x_[j_offset_q(row)] = delta_v_[row - num_pq_];
             }
+        }
+        // Jacobian matrix is already stored in compressed sparse column format.
         if (verbose_) {
-            writer::println("Jacobian matrix");
-            writer::print_mat(jacobian);
+            printer::println("Jacobian matrix");
+            printer::print_mat(arma::sp_mat(j_row_indices_, j_col_ptrs_, j_values_, j_size_, j_size_));
         }
-        // Transform into a sparse matrix for spsolve().
-        j_ = jacobian;
+        profiler::scope timer("factorize");
+        if (mixed_precision_) {
+            j_values_single_.set_size(j_values_.n_elem);
+            for (auto k = 0U; k < j_values_.n_elem; ++k) {
+                j_values_single_[k] = static_cast<float>(j_values_[k]);
+            }
+            if (j_lu_single_.factorize(j_size_, j_col_ptrs_, j_row_indices_, j_values_single_)) {
+                if (verbose_ && !j_lu_single_.reused()) {
+                    print_factors("Jacobian matrix (single precision)", j_lu_single_);
+                }
+                return true;
+            }
+            // Falls back to double precision, if singular in single precision.
+            if (verbose_) {
+                printer::println("Jacobian matrix is singular in single precision.");
+            }
+        }
+        if (!j_lu_.factorize(j_size_, j_col_ptrs_, j_row_indices_, j_values_)) {
+            return false;
+        }
+        if (verbose_ && j_lu_.reused()) {
+            printer::println("Symbolic analysis of jacobian matrix reused.");
+        } else if (verbose_) {
+            print_factors("Jacobian matrix", j_lu_);
+        }
+        return true;
     }
 
-    void calc::update_f_x()
+    bool calc::solve_jacobian()
     {
-        vec_elem_foreach(delta_p_, [this](auto& elem, auto row)
+        profiler::scope timer("spsolve");
+        if (!j_lu_single_.factorized()) {
+            return j_lu_.solve(f_x_);
+        }
+        const auto max_abs = [](const arma::colvec& vec)
         {
-            p_[row] = calc_p(row);
-            elem = init_p_[row] - p_[row];
-        });
-        vec_elem_foreach(delta_q_, [this](auto& elem, auto row)
+            auto max = 0.0;
+            for (auto&& elem : vec) {
+                max = std::max(max, std::abs(elem));
+            }
+            return max;
+        };
+        // Each step solves the correction of x from residual r = F(x) - J * x, where only
+        // the residual should be in double precision.
+        const arma::colvec b = f_x_;
+        const auto b_max = max_abs(b);
+        auto& x = f_x_;
+        x.zeros();
+        auto r = b;
+        auto r_max = b_max;
+        arma::fvec d(j_size_);
+        for (auto step = 0U; step < max_refine && r_max > refine_tolerance * b_max; ++step) {
+            for (auto i = 0U; i < j_size_; ++i) {
+                d[i] = static_cast<float>(r[i]);
+            }
+            if (!j_lu_single_.solve(d)) {
+                return false;
+            }
+            for (auto i = 0U; i < j_size_; ++i) {
+                x[i] += d[i];
+            }
+            r = b;
+            for (auto col = 0U; col < j_size_; ++col) {
+                for (auto k = j_col_ptrs_[col]; k < j_col_ptrs_[col + 1]; ++k) {
+                    r[j_row_indices_[k]] -= j_values_[k] * x[col];
+                }
+            }
+            const auto new_r_max = max_abs(r);
+            if (step && !(new_r_max < r_max)) {
+                // Refinement diverges, as jacobian matrix is ill-conditioned in single precision.
+                for (auto i = 0U; i < j_size_; ++i) {
+                    x[i] -= d[i];
+                }
+                break;
+            }
+            if (step) {
+                ++n_refine_;
+            }
+            r_max = new_r_max;
+        }
+        return std::isfinite(r_max);
+    }
+
+    void calc::update_current()
+    {
+        node_range_foreach([this](unsigned first, unsigned last)
         {
-            q_[row] = calc_q(row);
-            elem = init_q_[row] - q_[row];
+            update_current(first, last);
         });
-        vec_elem_foreach(delta_v_, [this](auto& elem, auto row)
+    }
+
+    void calc::update_f_x()
+    {
+        profiler::scope timer("mismatch");
+        // Mismatches of a node only depend on its own current injection, which is computed
+        // for the range just before, while still in cache.
+        node_range_foreach([this](unsigned first, unsigned last)
         {
-            auto i = row + num_pq_;
-            elem = std::pow(init_v_[row], 2) - std::pow(e_[i], 2) - std::pow(f_[i], 2);
+            update_current(first, last);
+            for (auto row = first; row < std::min(last, num_nodes_ - 1); ++row) {
+                p_[row] = calc_p(row);
+                delta_p_[row] = init_p_[row] - p_[row];
+                if (row < num_pq_) {
+                    q_[row] = calc_q(row);
+                    delta_q_[row] = init_q_[row] - q_[row];
+                } else {
+                    const auto pv = row - num_pq_;
+                    delta_v_[pv] = std::pow(init_v_[pv], 2) - std::pow(e_[row], 2) - std::pow(f_[row], 2);
+                }
+            }
         });
         if (verbose_) {
-            writer::println("Delta P:");
-            writer::print_mat(delta_p_.t());
-            writer::println("Delta Q:");
-            writer::print_mat(delta_q_.t());
-            writer::println("Delta U^2:");
-            writer::print_mat(delta_v_.t());
+            printer::println("Delta P:");
+            printer::print_mat(delta_p_.t());
+            printer::println("Delta Q:");
+            printer::print_mat(delta_q_.t());
+            printer::println("Delta U^2:");
+            printer::print_mat(delta_v_.t());
         }
     }
 
-    unsigned calc::solve()
+    bool calc::solve_newton()
     {
-        if (verbose_) {
-            writer::println("Number of iterations: ", n_iter_, " (begin)");
+        {
+            profiler::scope timer("jacobian");
+            if (method_ == polar) {
+                jacobian_polar();
+            } else {
+                jacobian();
+            }
+        }
+        if (!prepare_solve()) {
+            return false;
+        }
+        // F(x) is overwritten with the correction vector.
+        if (!solve_jacobian()) {
+            return false;
+        }
+        const auto& x_vec = f_x_;
+        if (method_ == polar) {
+            for (auto row = 0U; row < num_nodes_ - 1; ++row) {
+                const std::complex<double> u(e_[row], f_[row]);
+                auto u_abs = std::abs(u);
+                if (row < num_pq_) {
+                    u_abs += x_vec[j_offset_q(row)];
+                }
+                const auto u_new = std::polar(u_abs, std::arg(u) + x_vec[j_offset_p(row)]);
+                e_[row] = u_new.real();
+                f_[row] = u_new.imag();
+            }
+            return true;
         }
-        jacobian();
-        prepare_solve();
-        const auto x_vec = spsolve(j_, f_x_, "superlu");
         vec_elem_foreach(f_, [&x_vec](auto& elem, auto row)
         {
             if (2 * row < x_vec.n_elem) {
@@ -354,15 +781,131 @@ namespace flow
                 elem += x_vec.at(2 * row + 1, 0);
             }
         });
+        return true;
+    }
+
+    bool calc::fdlf_init()
+    {
+        profiler::scope timer("fdlf_init");
+        // B' only considers reactance of edges, ignoring resistance, grounding
+        // admittance and transformer ratio. Swing node is excluded.
+        const auto size = num_nodes_ - 1;
+        arma::umat locations(2, 4 * num_edges());
+        arma::colvec values(locations.n_cols);
+        auto i = 0U;
+        const auto add = [&locations, &values, &i, size](unsigned row, unsigned col, double val)
+        {
+            if (row < size && col < size) {
+                locations.at(0, i) = row;
+                locations.at(1, i) = col;
+                values[i++] = val;
+            }
+        };
+        for (auto edge = 0U; edge < num_edges(); ++edge) {
+            if (!edges_.in_service[edge]) {
+                continue;
+            }
+            const auto m = node_offset(edges_.m[edge]);
+            const auto n = node_offset(edges_.n[edge]);
+            const auto b = 1 / edges_.x[edge];
+            add(m, m, b);
+            add(n, n, b);
+            add(m, n, -b);
+            add(n, m, -b);
+        }
+        locations.resize(2, i);
+        values.resize(i);
+        const arma::sp_mat b1(true, locations, values, size, size);
+        b1_lu_.set_ordering(elimination_order(size), true);
+        if (!b1_lu_.factorize(b1)) {
+            return false;
+        }
         if (verbose_) {
-            writer::println("Correction vector of voltage (real):");
-            writer::print_mat(e_.t());
-            writer::println("Correction vector of voltage (imaginary):");
-            writer::print_mat(f_.t());
+            print_factors("B'", b1_lu_);
+        }
+        // B'' is the negated imaginary part of node admittance matrix of PQ nodes.
+        locations.set_size(2, n_adm_.n_nonzero);
+        values.set_size(n_adm_.n_nonzero);
+        i = 0;
+        for (auto col = 0U; col < num_pq_; ++col) {
+            for (auto k = n_adm_.col_ptrs[col]; k < n_adm_.col_ptrs[col + 1]; ++k) {
+                const auto row = n_adm_.row_indices[k];
+                if (row < num_pq_) {
+                    locations.at(0, i) = row;
+                    locations.at(1, i) = col;
+                    values[i++] = -std::complex<double>(n_adm_.values[k]).imag();
+                }
+            }
+        }
+        locations.resize(2, i);
+        values.resize(i);
+        const arma::sp_mat b2(locations, values, num_pq_, num_pq_);
+        b2_lu_.set_ordering(elimination_order(num_pq_), true);
+        if (num_pq_ && !b2_lu_.factorize(b2)) {
+            return false;
+        }
+        if (verbose_ && num_pq_) {
+            print_factors("B''", b2_lu_);
+        }
+        return true;
+    }
+
+    bool calc::solve_fdlf()
+    {
+        profiler::scope timer("fdlf_solve");
+        // P-theta half iteration: B' * delta(theta) = delta(P) / U.
+        arma::colvec x_vec(num_nodes_ - 1);
+        vec_elem_foreach(x_vec, [this](auto& elem, auto row)
+        {
+            elem = delta_p_[row] / std::abs(std::complex<double>(e_[row], f_[row]));
+        });
+        if (!b1_lu_.solve(x_vec)) {
+            return false;
+        }
+        vec_elem_foreach(x_vec, [this](auto&& elem, auto row)
+        {
+            const auto u = std::complex<double>(e_[row], f_[row]) * std::polar(1.0, elem);
+            e_[row] = u.real();
+            f_[row] = u.imag();
+        });
+        // Q-V half iteration: B'' * delta(U) = delta(Q) / U, with the updated phase angle.
+        if (num_pq_) {
+            update_current();
+            x_vec.set_size(num_pq_);
+            vec_elem_foreach(x_vec, [this](auto& elem, auto row)
+            {
+                elem = (init_q_[row] - calc_q(row)) / std::abs(std::complex<double>(e_[row], f_[row]));
+            });
+            if (!b2_lu_.solve(x_vec)) {
+                return false;
+            }
+            vec_elem_foreach(x_vec, [this](auto&& elem, auto row)
+            {
+                const auto u = std::abs(std::complex<double>(e_[row], f_[row]));
+                e_[row] *= (u + elem) / u;
+                f_[row] *= (u + elem) / u;
+            });
+        }
+        return true;
+    }
+
+    unsigned calc::solve()
+    {
+        if (verbose_) {
+            printer::println("Number of iterations: ", n_iter_, " (begin)");
+        }
+        if (method_ == fdlf ? !solve_fdlf() : !solve_newton()) {
+            throw calc_error("Failed to solve correction vector.");
+        }
+        if (verbose_) {
+            printer::println("Correction vector of voltage (real):");
+            printer::print_mat(e_.t());
+            printer::println("Correction vector of voltage (imaginary):");
+            printer::print_mat(f_.t());
         }
         update_f_x();
         if (verbose_) {
-            writer::println("Number of iterations: ", n_iter_, " (end)");
+            printer::println("Number of iterations: ", n_iter_, " (end)");
         }
         return n_iter_++;
     }
@@ -381,52 +924,81 @@ namespace flow
 
     arma::mat calc::result()
     {
-        p_[num_nodes_ - 1] = calc_p(num_nodes_ - 1);
-        for (auto&& elem : p_) {
-            if (approx_zero(elem)) {
-                elem = 0;
-            }
-        }
-        vec_elem_foreach(delta_v_, [this](auto& elem, auto row)
-        {
-            auto i = row + num_pq_;
-            q_[i] = calc_q(i);
-        });
-        q_[num_nodes_ - 1] = calc_q(num_nodes_ - 1);
-        for (auto&& elem : q_) {
-            if (approx_zero(elem)) {
-                elem = 0;
-            }
-        }
         v_.zeros(num_nodes_);
-        vec_elem_foreach(v_, [this](auto& elem, auto col)
+        // We shall preserve the original node sequence.
+        arma::mat retval(num_nodes_, 4);
+        const auto zero_if_approx = [this](double& elem)
         {
-            elem = std::sqrt(std::pow(e_[col], 2) + std::pow(f_[col], 2));
             if (approx_zero(elem)) {
                 elem = 0;
             }
-        });
-        arma::colvec theta(num_nodes_);
-        vec_elem_foreach(theta, [this](auto& elem, auto row)
+        };
+        node_foreach([&retval, &zero_if_approx, this](unsigned row)
         {
-            elem = std::atan(f_[row] / e_[row]);
-            if (approx_zero(elem)) {
-                elem = 0;
+            // Active power of swing node, and reactive power of PV nodes and swing node.
+            if (row == num_nodes_ - 1) {
+                p_[row] = calc_p(row);
             }
+            if (row >= num_pq_) {
+                q_[row] = calc_q(row);
+            }
+            zero_if_approx(p_[row]);
+            zero_if_approx(q_[row]);
+            v_[row] = std::sqrt(std::pow(e_[row], 2) + std::pow(f_[row], 2));
+            zero_if_approx(v_[row]);
+            auto theta = std::atan(f_[row] / e_[row]);
+            zero_if_approx(theta);
+            const auto orig = nodes_.id[row];
+            retval.at(orig, 0) = v_[row];
+            retval.at(orig, 1) = theta;
+            retval.at(orig, 2) = p_[row];
+            retval.at(orig, 3) = q_[row];
         });
-        arma::colvec node_id(num_nodes_);
-        vec_elem_foreach(node_id, [this](auto& elem, auto row)
-        {
-            elem = nodes_[row].id;
-        });
-        arma::mat retval = join_rows(node_id, join_rows(join_rows(v_, theta), join_rows(p_, q_)));
-        // We shall preserve the original node sequence.
-        arma::mat sorted_retval(num_nodes_, 4);
-        retval.each_row([&sorted_retval](const arma::rowvec& row)
-        {
-            sorted_retval.row(row[0]) = row.subvec(1, row.n_elem - 1);
-        });
-        return sorted_retval;
+        return retval;
+    }
+
+    void calc::short_circuit_init()
+    {
+        // Load and generator admittance only modify diagonal elements, which are
+        // always in the sparsity pattern.
+        arma::cx_colvec values(n_adm_.values, n_adm_.n_nonzero);
+        if (!ignore_load_) {
+            // Note that we should use P(LD) and Q(LD).
+            for (auto i = 0U; i < num_pq_; ++i) {
+                values[n_adm_diag(i)] += std::complex<double>(-init_p_[i], init_q_[i]) / std::pow(v_[i], 2);
+            }
+        }
+        for (auto i = num_pq_; i < num_nodes_; ++i) {
+            values[n_adm_diag(i)] -= std::complex<double>(0, 1 / nodes_.x_d[i]);
+        }
+        if (!y_f_lu_.factorize(num_nodes_, n_adm_.col_ptrs, n_adm_.row_indices, values.memptr())) {
+            throw calc_error("Node admittance matrix for short circuit calculation is singular.");
+        }
+        if (verbose_) {
+            print_factors("Node admittance matrix", y_f_lu_);
+        }
+        solve_z_col();
+    }
+
+    void calc::solve_z_col()
+    {
+        // Z(:, n) = Y^-1 * e(n).
+        z_col_.zeros(num_nodes_);
+        z_col_[short_circuit_node_] = 1;
+        if (!y_f_lu_.solve(z_col_)) {
+            throw calc_error("Failed to solve node impedance.");
+        }
+    }
+
+    void calc::short_circuit_fault(unsigned id, const std::complex<double>& z_f)
+    {
+        unsigned offset;
+        if (!find_node(id, offset)) {
+            throw calc_error("Bad node ID for short circuit calculation.");
+        }
+        short_circuit_node_ = node_offset(offset);
+        z_f_ = z_f;
+        solve_z_col();
     }
 
     std::complex<double> calc::short_circuit_current()
@@ -437,14 +1009,13 @@ namespace flow
         } else {
             i_f_ = { e_[n], f_[n] };
         }
-        i_f_ /= std::complex<double>(n_imp_g_.at(n, n), n_imp_b_.at(n, n)) + z_f_;
+        i_f_ /= z_col_[n] + z_f_;
         return i_f_;
     }
 
     arma::mat calc::short_circuit_voltage()
     {
         u_f_.resize(num_nodes_);
-        using cx = std::complex<double>;
         const auto n = short_circuit_node_;
         vec_elem_foreach(u_f_, [n, this](auto& elem, auto row)
         {
@@ -453,8 +1024,7 @@ namespace flow
                 u_f = { e_[row], f_[row] };
                 u_i = { e_[n], f_[n] };
             }
-            elem = u_f - cx(n_imp_g_.at(row, n), n_imp_b_.at(row, n)) *
-                (u_i / (cx(n_imp_g_.at(n, n), n_imp_b_.at(n, n)) + z_f_));
+            elem = u_f - z_col_[row] * (u_i / (z_col_[n] + z_f_));
             if (approx_zero(elem.real())) {
                 elem.real(0);
             }
@@ -465,12 +1035,12 @@ namespace flow
         arma::cx_colvec u_f_orig(num_nodes_);
         vec_elem_foreach(u_f_, [&u_f_orig, this](auto&& elem, auto row)
         {
-            u_f_orig[nodes_[row].id] = elem;
+            u_f_orig[nodes_.id[row]] = elem;
         });
         if (verbose_) {
-            writer::println("Short circuit node voltage:");
+            printer::println("Short circuit node voltage:");
             for (auto&& elem : u_f_orig) {
-                writer::print_complex("", elem);
+                printer::print_complex("", elem);
             }
         }
         return join_rows(arma::real(u_f_orig), arma::imag(u_f_orig));
@@ -478,21 +1048,323 @@ namespace flow
 
     arma::mat calc::short_circuit_edge_current()
     {
-        arma::cx_vec edge_current(edges_.size());
-        auto i = 0U;
+        arma::cx_vec edge_current(num_edges());
         if (verbose_)
-            writer::println("Short circuit edge current:");
-        for (auto&& edge : edges_) {
-            const auto admittance = -edge.admittance();
-            const auto m = node_offset(edge.m);
-            const auto n = node_offset(edge.n);
-            edge_current[i] = (u_f_[m] - u_f_[n] / (edge.k ? edge.k : 1)) * admittance;
+            printer::println("Short circuit edge current:");
+        for (auto i = 0U; i < num_edges(); ++i) {
+            // Edges out of service (after switching events) carry no current.
+            if (!edges_.in_service[i]) {
+                edge_current[i] = 0;
+            } else {
+                const std::complex<double> admittance(-edges_.y_re[i], -edges_.y_im[i]);
+                const auto m = node_offset(edges_.m[i]);
+                const auto n = node_offset(edges_.n[i]);
+                edge_current[i] = (u_f_[m] - u_f_[n] * edges_.tap_mn[i]) * admittance;
+            }
             if (verbose_) {
-                writer::print_complex(std::to_string(edge.m + 1) + ',' +
-                    std::to_string(edge.n + 1) + ": ", edge_current[i]);
+                printer::print_complex(std::to_string(node_ids_[edges_.m[i]]) + ',' +
+                    std::to_string(node_ids_[edges_.n[i]]) + ": ", edge_current[i]);
             }
-            ++i;
         }
         return join_rows(arma::real(edge_current), arma::imag(edge_current));
     }
+
+    arma::cx_colvec calc::prefault_voltage() const
+    {
+        arma::cx_colvec u(num_nodes_);
+        vec_elem_foreach(u, [this](auto& elem, auto row)
+        {
+            elem = ignore_load_ ? 1 : std::complex<double>(e_[row], f_[row]);
+        });
+        return u;
+    }
+
+    void calc::short_circuit_block(unsigned block, const arma::cx_colvec& u, arma::mat& rows) const
+    {
+        const auto n_faults = static_cast<unsigned>(short_circuit_nodes_.size());
+        const auto n_z_f = static_cast<unsigned>(z_fs_.size());
+        const auto real_or_zero = [this](double val)
+        {
+            return approx_zero(val) ? 0 : val;
+        };
+        // Columns of node impedance matrix are solved together, with the shared factorization.
+        const auto first = block * sweep_block_size;
+        const auto n_cols = std::min(sweep_block_size, n_faults - first);
+        arma::cx_mat z(num_nodes_, n_cols, arma::fill::zeros);
+        for (auto col = 0U; col < n_cols; ++col) {
+            z.at(short_circuit_nodes_[first + col], col) = 1;
+        }
+        if (!y_f_lu_.solve(z)) {
+            throw calc_error("Failed to solve node impedance.");
+        }
+        rows.set_size(n_cols * n_z_f, 5 + 2 * num_nodes_);
+        for (auto col = 0U; col < n_cols; ++col) {
+            const auto n = short_circuit_nodes_[first + col];
+            for (auto i = 0U; i < n_z_f; ++i) {
+                const auto row = col * n_z_f + i;
+                const auto i_f = u[n] / (z.at(n, col) + z_fs_[i]);
+                rows.at(row, 0) = node_ids_[nodes_.id[n]];
+                rows.at(row, 1) = z_fs_[i].real();
+                rows.at(row, 2) = z_fs_[i].imag();
+                rows.at(row, 3) = i_f.real();
+                rows.at(row, 4) = i_f.imag();
+                for (auto node = 0U; node < num_nodes_; ++node) {
+                    const auto u_f = u[node] - z.at(node, col) * i_f;
+                    const auto offset = 5 + 2 * nodes_.id[node];
+                    rows.at(row, offset) = real_or_zero(u_f.real());
+                    rows.at(row, offset + 1) = real_or_zero(u_f.imag());
+                }
+            }
+        }
+    }
+
+    void calc::stamp_edge(unsigned edge, double sign)
+    {
+        const auto stamp = edge_stamp(edge);
+        const auto offsets = edge_offsets(edge);
+        const auto values = arma::access::rwp(n_adm_.values);
+        values[offsets[0]] += sign * stamp[0];
+        values[offsets[1]] += sign * stamp[1];
+        values[offsets[2]] += sign * stamp[2];
+        values[offsets[3]] += sign * stamp[2];
+        update_split_node_admittance(offsets);
+    }
+
+    bool calc::update_fdlf(unsigned m, unsigned n, const std::array<std::complex<double>, 3>& delta, double delta_b)
+    {
+        // B' excludes swing node, and B'' only includes PQ nodes, which are sorted first.
+        return update_edge_block(b1_lu_, m, n, num_nodes_ - 1, {{ delta_b, delta_b, -delta_b }}) &&
+            update_edge_block(b2_lu_, m, n, num_pq_, {{ -delta[0].imag(), -delta[1].imag(), -delta[2].imag() }});
+    }
+
+    void calc::switch_edge(unsigned edge, bool in_service, double k)
+    {
+        if (edge >= num_edges()) {
+            throw calc_error("Bad edge offset for switching.");
+        }
+        const auto m = node_offset(edges_.m[edge]);
+        const auto n = node_offset(edges_.n[edge]);
+        // Change of the 2x2 block of the edge in node admittance matrix and B'.
+        std::array<std::complex<double>, 3> delta = {};
+        auto delta_b = 0.0;
+        const auto add = [&](double sign)
+        {
+            stamp_edge(edge, sign);
+            const auto stamp = edge_stamp(edge);
+            for (auto i = 0U; i < delta.size(); ++i) {
+                delta[i] += sign * stamp[i];
+            }
+            delta_b += sign / edges_.x[edge];
+        };
+        if (edges_.in_service[edge]) {
+            add(-1);
+        }
+        edges_.in_service[edge] = in_service;
+        edges_.k[edge] = k;
+        edge_factors(edge, edge + 1);
+        if (in_service) {
+            add(1);
+        }
+        // Jacobian matrix is refactorized in each iteration anyway, and its symbolic analysis
+        // is kept, as sparsity pattern of node admittance matrix does not change.
+        // Node admittance matrix for short circuit also depends on load flow result (through
+        // load admittance), so that it is factorized by short_circuit_init() after solving.
+        if (method_ == fdlf && b1_lu_.factorized() && !update_fdlf(m, n, delta, delta_b) && !fdlf_init()) {
+            throw calc_error("Matrix B' or B'' is singular.");
+        }
+    }
+
+    std::vector<bool> calc::bridges() const
+    {
+        // Adjacency lists of in-service edges, in compressed form.
+        const auto n_edges = num_edges();
+        std::vector<unsigned> adj_ptrs(num_nodes_ + 1), adj_edges(2 * n_edges);
+        for (auto i = 0U; i < n_edges; ++i) {
+            if (edges_.in_service[i]) {
+                ++adj_ptrs[edges_.m[i] + 1];
+                ++adj_ptrs[edges_.n[i] + 1];
+            }
+        }
+        std::partial_sum(adj_ptrs.begin(), adj_ptrs.end(), adj_ptrs.begin());
+        auto next = adj_ptrs;
+        for (auto i = 0U; i < n_edges; ++i) {
+            if (edges_.in_service[i]) {
+                adj_edges[next[edges_.m[i]]++] = i;
+                adj_edges[next[edges_.n[i]]++] = i;
+            }
+        }
+        // Tarjan's bridge-finding algorithm, with an explicit stack. The edge leading to
+        // a node (rather than the parent node) is skipped, so that parallel edges are not bridges.
+        struct frame
+        {
+            unsigned node, parent, pos;
+        };
+        std::vector<bool> retval(n_edges);
+        std::vector<unsigned> order(num_nodes_), low(num_nodes_);
+        std::vector<frame> stack;
+        auto counter = 0U;
+        for (auto root = 0U; root < num_nodes_; ++root) {
+            if (order[root]) {
+                continue;
+            }
+            order[root] = low[root] = ++counter;
+            stack.push_back({ root, n_edges, adj_ptrs[root] });
+            while (!stack.empty()) {
+                auto& top = stack.back();
+                if (top.pos < adj_ptrs[top.node + 1]) {
+                    const auto i = adj_edges[top.pos++];
+                    if (i == top.parent) {
+                        continue;
+                    }
+                    const auto node = edges_.m[i] == top.node ? edges_.n[i] : edges_.m[i];
+                    if (order[node]) {
+                        low[top.node] = std::min(low[top.node], order[node]);
+                    } else {
+                        order[node] = low[node] = ++counter;
+                        stack.push_back({ node, i, adj_ptrs[node] });
+                    }
+                    continue;
+                }
+                const auto done = top;
+                stack.pop_back();
+                if (!stack.empty()) {
+                    const auto parent = stack.back().node;
+                    low[parent] = std::min(low[parent], low[done.node]);
+                    if (low[done.node] > order[parent]) {
+                        retval[done.parent] = true;
+                    }
+                }
+            }
+        }
+        return retval;
+    }
+
+    bool calc::solve_outage(unsigned edge, const calc& base, unsigned max, unsigned& n_iter)
+    {
+        // B' and B'' without outage are factorized once, and updated for each outage.
+        auto converged = method_ != fdlf || (b1_lu_.factorized() && !b1_lu_.rank() && !b2_lu_.rank()) ||
+            fdlf_init();
+        edges_.in_service[edge] = false;
+        stamp_edge(edge, -1);
+        if (converged && method_ == fdlf) {
+            const auto stamp = edge_stamp(edge);
+            converged = update_fdlf(node_offset(edges_.m[edge]), node_offset(edges_.n[edge]),
+                {{ -stamp[0], -stamp[1], -stamp[2] }}, -1 / edges_.x[edge]);
+        }
+        // Warm start from the converged base case.
+        e_ = base.e_;
+        f_ = base.f_;
+        n_iter = 0;
+        if (converged) {
+            update_f_x();
+            while (true) {
+                const auto max_delta = get_max();
+                if (!std::isfinite(max_delta) || (max_delta > epsilon_ && n_iter >= max)) {
+                    converged = false;
+                    break;
+                }
+                if (max_delta <= epsilon_) {
+                    break;
+                }
+                if (method_ == fdlf ? !solve_fdlf() : !solve_newton()) {
+                    converged = false;
+                    break;
+                }
+                update_f_x();
+                ++n_iter;
+            }
+        }
+        // Restore the exact values of the base case.
+        edges_.in_service[edge] = true;
+        const auto offsets = edge_offsets(edge);
+        for (auto&& offset : offsets) {
+            arma::access::rw(n_adm_.values[offset]) = base.n_adm_.values[offset];
+        }
+        update_split_node_admittance(offsets);
+        b1_lu_.revert();
+        b2_lu_.revert();
+        return converged;
+    }
+
+    void calc::reset(const calc& base)
+    {
+        nodes_ = base.nodes_;
+        init_p_ = base.init_p_;
+        init_q_ = base.init_q_;
+        init_v_ = base.init_v_;
+        e_ = base.e_;
+        f_ = base.f_;
+        n_iter_ = 1;
+        update_f_x();
+    }
+
+    arma::mat calc::contingency(unsigned max, double u_min, double u_max, unsigned threads) const
+    {
+        const auto n_edges = num_edges();
+        const auto islanding = bridges();
+        arma::mat retval(n_edges, 11, arma::fill::zeros);
+        // Each thread works on its own copy of the base case. Since the sparsity pattern of
+        // node admittance matrix is kept on outage, symbolic analysis of jacobian matrix is shared.
+        threads = std::min(parallel::threads(threads), std::max(n_edges, 1U));
+        std::vector<calc> workers(threads, *this);
+        for (auto&& worker : workers) {
+            worker.verbose_ = false;
+            worker.set_threads(1);
+        }
+        parallel::for_each(n_edges, threads, [&](unsigned edge, unsigned thread)
+        {
+            auto& worker = workers[thread];
+            retval.at(edge, 0) = edge + 1;
+            retval.at(edge, 1) = node_ids_[edges_.m[edge]];
+            retval.at(edge, 2) = node_ids_[edges_.n[edge]];
+            if (islanding[edge]) {
+                retval.at(edge, 3) = 2;
+                return;
+            }
+            unsigned n_iter;
+            if (!worker.solve_outage(edge, *this, max, n_iter)) {
+                retval.at(edge, 3) = 1;
+                retval.at(edge, 4) = n_iter;
+                return;
+            }
+            retval.at(edge, 4) = n_iter;
+            auto violations = 0U;
+            auto severity = 0.0;
+            auto lowest = 0U, highest = 0U;
+            std::vector<double> u(num_nodes_);
+            for (auto node = 0U; node < num_nodes_; ++node) {
+                u[node] = std::abs(std::complex<double>(worker.e_[node], worker.f_[node]));
+                if (u[node] < u_min) {
+                    ++violations;
+                    severity += u_min - u[node];
+                } else if (u[node] > u_max) {
+                    ++violations;
+                    severity += u[node] - u_max;
+                }
+                if (u[node] < u[lowest]) {
+                    lowest = node;
+                }
+                if (u[node] > u[highest]) {
+                    highest = node;
+                }
+            }
+            retval.at(edge, 5) = violations;
+            retval.at(edge, 6) = severity;
+            retval.at(edge, 7) = u[lowest];
+            retval.at(edge, 8) = node_ids_[nodes_.id[lowest]];
+            retval.at(edge, 9) = u[highest];
+            retval.at(edge, 10) = node_ids_[nodes_.id[highest]];
+        });
+        // Most severe cases come first.
+        std::vector<arma::uword> rank(n_edges);
+        std::iota(rank.begin(), rank.end(), 0);
+        std::stable_sort(rank.begin(), rank.end(), [&retval](auto r1, auto r2)
+        {
+            if (retval.at(r1, 3) != retval.at(r2, 3)) {
+                return retval.at(r1, 3) > retval.at(r2, 3);
+            }
+            return retval.at(r1, 6) > retval.at(r2, 6);
+        });
+        return retval.rows(arma::uvec(rank));
+    }
 }
@@ -6,120 +6,139 @@
 
 #pragma once
 
+#include "kernel.hpp"
+#include "lu.hpp"
+#include "ordering.hpp"
+#include "parallel.hpp"
+#include "thread_pool.hpp"
+
 #include <armadillo>
+#include <array>
+#include <numeric>
+#include <unordered_map>
 #include <vector>
 
 namespace flow
 {
-    /// Power flow calculation.
+    /// Power flow calculation. Errors are reported by throwing calc_error.
     class calc
     {
-        /// Structure of node data.
-        struct node_data
+    public:
+        /// Method of power flow calculation.
+        enum method_type {
+            /// Newton's method in rectangular coordinates.
+            newton,
+            /// Newton's method in polar coordinates.
+            polar,
+            /// Fast decoupled load flow (XB version).
+            fdlf
+        };
+
+    private:
+        /// Node data, stored by column (in sorted node order), so that each attribute is
+        /// contiguous. Node type is given by offset: PQ nodes come first, followed by PV nodes,
+        /// while swing node is the last.
+        struct node_columns
         {
-            /// Node ID.
-            unsigned id;
+            /// Node offset in original order.
+            std::vector<unsigned> id;
 
             /// Voltage (real);
-            double v;
+            arma::colvec v;
 
             /// Generator (active power)
-            double g;
+            arma::colvec g;
 
             /// Load (active power)
-            double p;
+            arma::colvec p;
 
             /// Load (reactive power)
-            double q;
+            arma::colvec q;
 
             /// Generator admittance
-            double x_d;
-
-            /// Node type.
-            enum node_type {
-                pq, pv, swing
-            } type;
+            arma::colvec x_d;
         };
 
-        /// Structure of edge data.
-        struct edge_data
+        /// Edge data, stored by column, so that each attribute is contiguous.
+        struct edge_columns
         {
-            /// First and second node ID.
-            unsigned m, n;
+            /// Original offset of first and second node.
+            std::vector<unsigned> m, n;
 
             /// Resistance (real).
-            double r;
+            arma::colvec r;
 
             /// Resistance (imaginary).
-            double x;
+            arma::colvec x;
 
             /// Grounding admittance (imaginary).
-            double b;
+            arma::colvec b;
 
             /// Transformer ratio.
-            double k;
-
-            /**
-             * Get admittance of edge.
-             * 
-             * @return Admittance (complex).
-             */
-            std::complex<double> admittance() const
-            {
-                const auto deno = r * r + x * x;
-                return { r / deno, -x / deno };
-            }
+            arma::colvec k;
 
-            /**
-             * Get impedance of edge.
-             *
-             * @return Admittance (complex).
-             */
-            std::complex<double> impedance() const
-            {
-                return { r, x };
-            }
+            /// Whether edge is in service.
+            std::vector<bool> in_service;
 
-            /**
-             * Get grounding admittance.
-             * 
-             * @return Grounding admittance (complex).
-             */
-            std::complex<double> grounding_admittance() const
-            {
-                return { 0, b };
-            };
+            /// Admittance of edge (real and imaginary part), computed from r and x.
+            arma::colvec y_re, y_im;
+
+            /// Grounding admittance added to Y(m, m) and Y(n, n) (zero for transformers).
+            arma::colvec shunt;
+
+            /// Factors of admittance for Y(n, n) and Y(m, n), which are 1/k^2 and 1/k
+            /// for transformers, 1 otherwise.
+            arma::colvec tap_nn, tap_mn;
         };
 
-        /// Vector of nodes.
-        std::vector<node_data> nodes_;
+        /// Columns of nodes.
+        node_columns nodes_;
 
         /// Number of nodes.
         unsigned num_nodes_ = 0;
 
+        /// Whether node IDs are given explicitly in node data.
+        bool explicit_id_ = false;
+
+        /// External node IDs, in original node order.
+        std::vector<unsigned> node_ids_;
+
+        /// Sorted node offsets, in original node order.
+        std::vector<unsigned> node_offsets_;
+
+        /// Original node offsets by external node ID (only if node IDs are given explicitly).
+        std::unordered_map<unsigned, unsigned> id_offsets_;
+
         /// Number of PQ nodes and PV nodes.
         unsigned num_pq_ = 0, num_pv_ = 0;
 
-        /// Vector of edges.
-        std::vector<edge_data> edges_;
+        /// Columns of edges.
+        edge_columns edges_;
 
-        /// Adjacency matrix of nodes.
-        arma::uchar_mat adj_;
+        /// Node admittance matrix (sparse, in sorted node order).
+        arma::sp_cx_mat n_adm_;
 
-        /// Node admittance matrix.
-        arma::cx_mat n_adm_;
+        /// Node admittance matrix with 32-bit indices, and values split into real and imaginary
+        /// parts (same sparsity pattern as `n_adm_`), for vectorized kernels.
+        std::vector<std::uint32_t> n_adm_ptrs_, n_adm_indices_;
+        std::vector<double> n_adm_g_, n_adm_b_;
 
-        /// Node admittance matrix in original node order.
-        arma::cx_mat n_adm_orig_;
+        /// Whether node admittance matrix is precomputed, rather than built from edges.
+        bool n_adm_preset_ = false;
 
-        /// Node admittance matrix.
-        arma::mat n_adm_g_, n_adm_b_;
+        /// Method of fill-reducing ordering of nodes.
+        ordering::method_type ordering_ = ordering::colamd;
 
-        /// Node impedance matrix.
-        arma::cx_mat n_imp_;
+        /// Sorted node offsets in elimination order, computed once on the graph of node
+        /// admittance matrix, from which the column ordering of each factorized matrix is
+        /// derived (empty if each matrix is ordered by COLAMD).
+        std::vector<unsigned> elimination_order_;
 
-        /// Node impedance matrix.
-        arma::mat n_imp_g_, n_imp_b_;
+        /// LU factorization of node admittance matrix modified for short circuit calculation.
+        lu<std::complex<double>> y_f_lu_;
+
+        /// Column of node impedance matrix corresponding to short circuit node.
+        arma::cx_colvec z_col_;
 
         /// Given values of power and voltage.
         arma::colvec init_p_, init_q_, init_v_;
@@ -127,17 +146,51 @@ namespace flow
         /// Correction vector of voltage.
         arma::colvec e_, f_;
 
+        /// Current injection of nodes (I = Y * U), updated along with voltage.
+        arma::cx_colvec i_;
+
         /// Imbalance of active/reactive power and voltage.
         arma::colvec delta_p_, delta_q_, delta_v_;
 
-        /// Submatrix of Jacobian matrix.
-        arma::mat j_h_, j_n_, j_m_, j_l_, j_r_, j_s_;
+        /// Order of jacobian matrix.
+        unsigned j_size_ = 0;
+
+        /// Sparsity pattern of Jacobian matrix (compressed sparse column).
+        arma::uvec j_col_ptrs_, j_row_indices_;
+
+        /// Non-zero elements of Jacobian matrix.
+        arma::colvec j_values_;
+
+        /// Offsets in `j_values_` of the 2x2 Jacobian block of each element in node admittance matrix.
+        arma::umat j_scatter_;
 
         /// F(x) of jacobian matrix.
         arma::colvec f_x_;
 
-        /// Jacobian matrix (sparse).
-        arma::sp_mat j_;
+        /// LU factorization of jacobian matrix, which reuses symbolic analysis across iterations.
+        lu<double> j_lu_;
+
+        /// Whether jacobian matrix is factorized in single precision, with double precision
+        /// accuracy recovered by iterative refinement.
+        bool mixed_precision_ = false;
+
+        /// Non-zero elements of jacobian matrix in single precision.
+        arma::fvec j_values_single_;
+
+        /// LU factorization of jacobian matrix in single precision.
+        lu<float> j_lu_single_;
+
+        /// Number of refinement steps done in total.
+        unsigned n_refine_ = 0;
+
+        /// Max number of refinement steps for each solve.
+        static constexpr unsigned max_refine = 10;
+
+        /// Max residual relative to right hand side, below which refinement stops.
+        static constexpr double refine_tolerance = 1e-12;
+
+        /// Constant LU factorization of B' and B'' (fast decoupled load flow).
+        lu<double> b1_lu_, b2_lu_;
 
         /// Power vector of nodes.
         arma::colvec p_, q_;
@@ -151,18 +204,27 @@ namespace flow
         /// Whether to ignore load current when calculating short circuit.
         bool ignore_load_;
 
-        /// Node ID of three-phase short circuit.
+        /// Node offset of three-phase short circuit.
         unsigned short_circuit_node_;
 
         /// Transition impedance of node.
         std::complex<double> z_f_;
 
+        /// Node offsets of three-phase short circuit (when calculating on multiple nodes).
+        std::vector<unsigned> short_circuit_nodes_;
+
+        /// Transition impedances (when calculating on multiple nodes).
+        std::vector<std::complex<double>> z_fs_;
+
         /// Value of short circuit current.
         std::complex<double> i_f_;
 
         /// Vector of short circuit voltage.
         arma::cx_colvec u_f_;
 
+        /// Method of power flow calculation.
+        method_type method_ = newton;
+
         /// Whether verbose output is enabled.
         bool verbose_;
 
@@ -171,38 +233,234 @@ namespace flow
 
         /// Number of iterations.
         unsigned n_iter_ = 1;
+
+        /// Number of threads for evaluating jacobian matrix, mismatches and results.
+        unsigned threads_ = 1;
+
+        /// Bounds of node ranges evaluated by each thread, balanced by non-zero elements
+        /// of node admittance matrix.
+        std::vector<unsigned> node_ranges_ { 0 };
+
+        /// Threads evaluating node ranges, kept across iterations (one for each range).
+        /// Copies of a calculation do not share threads.
+        mutable thread_pool pool_;
+
+        /// Min number of non-zero elements of node admittance matrix for each thread, below
+        /// which the overhead of threads outweighs.
+        static constexpr unsigned min_nonzeros_per_thread = 1 << 14;
         
         /**
-         * Get offset of sorted node by ID.
+         * Get offset of sorted node by original offset.
          * 
-         * @param id Node ID.
+         * @param id Original node offset.
          * @return Node offset.
          */
-        unsigned node_offset(unsigned id) const;
+        unsigned node_offset(unsigned id) const
+        {
+            return node_offsets_[id];
+        }
 
-        /// G(i, j) * e(i) + B(i, j) * f(i)
-        double j_elem_g_b(unsigned row, unsigned col) const;
+        /**
+         * Find original offset of node by external node ID.
+         *
+         * @param id External node ID.
+         * @param offset Original node offset.
+         * @return Whether node exists.
+         */
+        bool find_node(unsigned id, unsigned& offset) const;
 
-        /// B(i, j) * e(i) - G(i, j) * f(i)
-        double j_elem_b_g(unsigned row, unsigned col) const;
+        /**
+         * Get offset of a diagonal element in non-zero elements of node admittance matrix.
+         *
+         * @param node Node offset.
+         * @return Offset in non-zero elements.
+         */
+        arma::uword n_adm_diag(unsigned node) const
+        {
+            return n_adm_offset(node, node);
+        }
+
+        /**
+         * Build node admittance matrix from edges.
+         */
+        void build_node_admittance();
 
-        /// G(i, i) * e(i) + B(i, i) * f(i)
-        double j_elem_b(unsigned row) const
+        /**
+         * Get offset of an element in non-zero elements of node admittance matrix.
+         *
+         * @param row Row offset.
+         * @param col Column offset.
+         * @return Offset in non-zero elements.
+         */
+        arma::uword n_adm_offset(unsigned row, unsigned col) const
         {
-            return j_elem_g_b(row, row);
+            const auto begin = n_adm_.row_indices + n_adm_.col_ptrs[col];
+            const auto end = n_adm_.row_indices + n_adm_.col_ptrs[col + 1];
+            return std::lower_bound(begin, end, row) - n_adm_.row_indices;
         }
 
-        /// B(i, i) * e(i) - G(i, i) * f(i)
-        double j_elem_d(unsigned row) const
+        /**
+         * Compute admittance, grounding admittance and transformer factors of a range of edges
+         * from their parameters. Each column is written in a simple loop without branches, which
+         * can be vectorized.
+         *
+         * @param first First edge.
+         * @param last Edge after the last one.
+         */
+        void edge_factors(unsigned first, unsigned last);
+
+        /**
+         * Get contribution of edge to node admittance matrix.
+         *
+         * @param edge Edge offset.
+         * @return Y(m, m), Y(n, n) and Y(m, n) (which equals Y(n, m)).
+         */
+        std::array<std::complex<double>, 3> edge_stamp(unsigned edge) const
         {
-            return j_elem_b_g(row, row);
+            const auto g = edges_.y_re[edge], b = edges_.y_im[edge], shunt = edges_.shunt[edge];
+            const auto tap_nn = edges_.tap_nn[edge], tap_mn = edges_.tap_mn[edge];
+            return {{ { g, b + shunt }, { g * tap_nn, b * tap_nn + shunt }, { -g * tap_mn, -b * tap_mn } }};
+        }
+
+        /**
+         * Get offsets of the elements of an edge in non-zero elements of node admittance matrix.
+         *
+         * @param edge Edge offset.
+         * @return Offsets of Y(m, m), Y(n, n), Y(m, n) and Y(n, m).
+         */
+        std::array<arma::uword, 4> edge_offsets(unsigned edge) const
+        {
+            const auto m = node_offset(edges_.m[edge]);
+            const auto n = node_offset(edges_.n[edge]);
+            return {{ n_adm_offset(m, m), n_adm_offset(n, n), n_adm_offset(m, n), n_adm_offset(n, m) }};
+        }
+
+        /**
+         * Add the contribution of an edge to node admittance matrix in place. Elements of
+         * the edge are always in the sparsity pattern, so that the pattern does not change.
+         *
+         * @param edge Edge offset.
+         * @param sign 1 to add, -1 to remove.
+         */
+        void stamp_edge(unsigned edge, double sign);
+
+        /**
+         * Get elimination order of the leading nodes, for a matrix which only includes them
+         * (as PQ nodes are sorted first, and swing node is the last).
+         *
+         * @param size Number of leading nodes.
+         * @return Node offsets in elimination order (empty if ordered by COLAMD).
+         */
+        std::vector<unsigned> elimination_order(unsigned size) const;
+
+        /// Number of fault nodes calculated together in short circuit sweep.
+        static constexpr unsigned sweep_block_size = 16;
+
+        /**
+         * Get node voltage before short circuit.
+         */
+        arma::cx_colvec prefault_voltage() const;
+
+        /**
+         * Calculate a block of fault nodes in short circuit sweep.
+         *
+         * @param block Offset of block.
+         * @param u Node voltage before short circuit.
+         * @param rows Rows of results, see short_circuit_sweep().
+         */
+        void short_circuit_block(unsigned block, const arma::cx_colvec& u, arma::mat& rows) const;
+
+        /**
+         * Solve the column of node impedance matrix corresponding to short circuit node.
+         */
+        void solve_z_col();
+
+        /**
+         * Update a factorization with the change of the 2x2 block of an edge, without
+         * refactorizing. Rows and columns beyond the order of the matrix are ignored.
+         *
+         * @param factors Factorization to be updated.
+         * @param m Sorted offset of first node.
+         * @param n Sorted offset of second node.
+         * @param size Order of the factorized matrix.
+         * @param delta Change of elements (m, m), (n, n) and (m, n) (which equals (n, m)).
+         * @return Whether update is successful.
+         */
+        template <typename T>
+        static bool update_edge_block(lu<T>& factors, unsigned m, unsigned n, unsigned size, const std::array<T, 3>& delta)
+        {
+            std::vector<arma::uword> rows;
+            for (auto&& node : { m, n }) {
+                if (node < size) {
+                    rows.push_back(node);
+                }
+            }
+            if (rows.empty()) {
+                return true;
+            }
+            arma::Mat<T> block(rows.size(), rows.size());
+            for (auto i = 0U; i < rows.size(); ++i) {
+                for (auto j = 0U; j < rows.size(); ++j) {
+                    block.at(i, j) = rows[i] != rows[j] ? delta[2] : rows[i] == m ? delta[0] : delta[1];
+                }
+            }
+            return factors.update(arma::uvec(rows), block);
+        }
+
+        /**
+         * Update factorization of B' and B'' with the change of an edge.
+         *
+         * @param m Sorted offset of first node.
+         * @param n Sorted offset of second node.
+         * @param delta Change of Y(m, m), Y(n, n) and Y(m, n) in node admittance matrix.
+         * @param delta_b Change of susceptance of the edge in B'.
+         * @return Whether update is successful.
+         */
+        bool update_fdlf(unsigned m, unsigned n, const std::array<std::complex<double>, 3>& delta, double delta_b);
+
+        /**
+         * Permute a sparse matrix from sorted node order to original node order.
+         *
+         * @param mat Matrix in sorted node order.
+         * @return Matrix in original node order.
+         */
+        template <typename T>
+        arma::SpMat<T> to_orig_order(const arma::SpMat<T>& mat) const
+        {
+            arma::umat locations(2, mat.n_nonzero);
+            arma::Col<T> values(mat.n_nonzero);
+            auto i = 0U;
+            for (auto it = mat.begin(); it != mat.end(); ++it, ++i) {
+                locations.at(0, i) = nodes_.id[it.row()];
+                locations.at(1, i) = nodes_.id[it.col()];
+                values[i] = *it;
+            }
+            return arma::SpMat<T>(locations, values, num_nodes_, num_nodes_);
+        }
+
+        /// G(i, j) * e(i) + B(i, j) * f(i)
+        double j_elem_g_b(const std::complex<double>& y, unsigned row) const
+        {
+            return y.real() * e_[row] + y.imag() * f_[row];
+        }
+
+        /// B(i, j) * e(i) - G(i, j) * f(i)
+        double j_elem_b_g(const std::complex<double>& y, unsigned row) const
+        {
+            return y.imag() * e_[row] - y.real() * f_[row];
         }
 
         /// sum(i == j || adj(i, j), B(i, j) * f(j) - G(i, j) * e(j))
-        double j_elem_a(unsigned row) const;
+        double j_elem_a(unsigned row) const
+        {
+            return -i_[row].real();
+        }
         
         /// sum(i == j || adj(i, j), G(i, j) * f(j) + B(i, j) * e(j))
-        double j_elem_c(unsigned row) const;
+        double j_elem_c(unsigned row) const
+        {
+            return i_[row].imag();
+        }
 
         /**
          * Traverse a matrix.
@@ -234,20 +492,166 @@ namespace flow
             }
         }
 
+        /**
+         * Call a function for each range of nodes (in sorted order), with nodes split into
+         * ranges of similar number of non-zero elements, which are evaluated in parallel.
+         * Each node should be independent of others, so that result does not depend on threads.
+         *
+         * @param func Callback for each range, with the first node offset and the one after the last.
+         */
+        template <typename F>
+        void node_range_foreach(F func) const
+        {
+            pool_.for_each(node_ranges_.size() - 1, [&](unsigned range, unsigned)
+            {
+                func(node_ranges_[range], node_ranges_[range + 1]);
+            });
+        }
+
+        /**
+         * Call a function for each node (in sorted order), in parallel by ranges of nodes.
+         *
+         * @param func Callback for each node offset.
+         */
+        template <typename F>
+        void node_foreach(F func) const
+        {
+            node_range_foreach([&func](unsigned first, unsigned last)
+            {
+                for (auto node = first; node < last; ++node) {
+                    func(node);
+                }
+            });
+        }
+
+        /**
+         * Split nodes into ranges for parallel evaluation, by non-zero elements of node
+         * admittance matrix.
+         */
+        void partition_nodes();
+
+        /**
+         * Split node admittance matrix into real and imaginary parts, for vectorized kernels.
+         */
+        void split_node_admittance();
+
+        /**
+         * Update split node admittance matrix at given offsets of non-zero elements.
+         *
+         * @param offsets Offsets in non-zero elements.
+         */
+        void update_split_node_admittance(const std::array<arma::uword, 4>& offsets)
+        {
+            for (auto&& offset : offsets) {
+                const std::complex<double> y = n_adm_.values[offset];
+                n_adm_g_[offset] = y.real();
+                n_adm_b_[offset] = y.imag();
+            }
+        }
+
+        /**
+         * Update current injection of a range of nodes from voltage.
+         *
+         * @param first First node offset.
+         * @param last Node offset after the last one.
+         */
+        void update_current(unsigned first, unsigned last)
+        {
+            // Node admittance matrix is symmetric, so that its compressed columns are
+            // also compressed rows.
+            kernel::spmv({ n_adm_ptrs_.data(), n_adm_indices_.data(), n_adm_g_.data(), n_adm_b_.data() },
+                e_.memptr(), f_.memptr(), first, last, i_.memptr());
+        }
+
+        /**
+         * Update current injection of nodes from voltage.
+         */
+        void update_current();
+
         /**
          * Update F(x) of jacobian matrix.
          */
         void update_f_x();
 
+        /**
+         * Derive sparsity pattern of jacobian matrix from network topology.
+         */
+        void jacobian_pattern();
+
+        /**
+         * Offset of the first variable (f or theta) and equation (P) of a node in jacobian matrix.
+         *
+         * @param node Node offset.
+         * @return Row and column offset.
+         */
+        unsigned j_offset_p(unsigned node) const
+        {
+            // In polar coordinates, PV nodes have no variable of voltage magnitude.
+            return method_ == polar && node >= num_pq_ ? num_pq_ + node : 2 * node;
+        }
+
+        /**
+         * Offset of the second variable (e or U) and equation (Q or U^2) of a node in jacobian matrix.
+         *
+         * @param node Node offset.
+         * @return Row and column offset.
+         */
+        unsigned j_offset_q(unsigned node) const
+        {
+            return 2 * node + 1;
+        }
+
         /**
          * Calculate jacobian matrix.
          */
         void jacobian();
 
+        /**
+         * Calculate jacobian matrix in polar coordinates.
+         */
+        void jacobian_polar();
+
+        /**
+         * Initialize power injections and voltage set points from node data.
+         */
+        void init_injections();
+
         /**
          * Prepare to solve the formula.
+         *
+         * @return Whether jacobian matrix is successfully factorized.
+         */
+        bool prepare_solve();
+
+        /**
+         * Solve J * x = F(x) in place with the factorization of jacobian matrix. If factorized
+         * in single precision, the solution is refined with residuals in double precision,
+         * until converged or no longer improved.
+         *
+         * @return Whether correction vector is successfully solved.
+         */
+        bool solve_jacobian();
+
+        /**
+         * Do one iteration of Newton's method (in rectangular or polar coordinates).
+         *
+         * @return Whether correction vector is successfully solved.
+         */
+        bool solve_newton();
+
+        /**
+         * Build and factorize B' and B'' for fast decoupled load flow.
+         *
+         * @return Whether B' and B'' are successfully factorized.
          */
-        void prepare_solve();
+        bool fdlf_init();
+
+        /**
+         * Do one iteration (a P-theta and a Q-V half iteration) of fast decoupled load flow.
+         *
+         * @return Whether correction vector is successfully solved.
+         */
+        bool solve_fdlf();
 
         /// Calculate active power of a node.
         double calc_p(unsigned row) const
@@ -273,34 +677,130 @@ namespace flow
          */
         explicit calc() = default;
 
+        /**
+         * Copy constructor. Symbolic analysis of factorizations is kept, but not the factors.
+         */
+        calc(const calc&) = default;
+
         /**
          * Initialize.
          */
         void init(
             const arma::mat&            nodes,
             const arma::mat&            edges,
+            bool                        explicit_id,
+            method_type                 method,
             bool                        verbose,
             double                      epsilon,
             bool                        short_circuit,
             bool                        ignore_load,
-            unsigned                    short_circuit_node,
-            const std::complex<double>& z_f);
+            const std::vector<unsigned>&              short_circuit_nodes,
+            const std::vector<std::complex<double>>&  z_f);
+
+        /**
+         * Initialize node admittance matrix, which is built from edges unless a precomputed
+         * one is given.
+         */
+        void admittance_init();
+
+        /**
+         * Get node admittance matrix. Should be called after admittance_init().
+         *
+         * @return Node admittance matrix, in original node order.
+         */
+        arma::sp_cx_mat node_admittance() const;
+
+        /**
+         * Use a precomputed node admittance matrix, instead of building it from edges.
+         * Should be called after init(), and before admittance_init().
+         *
+         * @param order Original node offset of each sorted node.
+         * @param n_adm Node admittance matrix, in sorted node order.
+         * @return Whether the matrix is used (false if node order or size mismatches, or if
+         *         sparsity pattern misses any diagonal or edge element, or is not symmetric).
+         */
+        bool set_node_admittance(const arma::uvec& order, arma::sp_cx_mat&& n_adm);
+
+        /**
+         * Get original node offset of each sorted node.
+         */
+        arma::uvec node_order() const;
+
+        /**
+         * Get node admittance matrix in sorted node order. Should be called after admittance_init().
+         */
+        const arma::sp_cx_mat& sorted_node_admittance() const
+        {
+            return n_adm_;
+        }
+
+        /**
+         * Calculate node impedance matrix (which is expensive, and only needed for output).
+         * Should be called after short_circuit_init().
+         *
+         * @return Node impedance matrix, in original node order.
+         */
+        arma::cx_mat node_impedance();
+
+        /**
+         * Set number of threads for evaluating jacobian matrix, mismatches and results.
+         * Small networks are always evaluated in one thread.
+         *
+         * @param threads Number of threads (0 for number of hardware threads).
+         */
+        void set_threads(unsigned threads);
 
         /**
-         * Calculate node admittance.
+         * Set method of fill-reducing ordering. Should be called before admittance_init().
+         *
+         * @param method Method of ordering.
          */
-        std::pair<arma::mat, arma::mat> node_admittance();
+        void set_ordering(ordering::method_type method)
+        {
+            ordering_ = method;
+        }
 
         /**
-         * Calculate node impedance. 
+         * Set whether jacobian matrix is factorized in single precision (with iterative
+         * refinement), which halves memory and bandwidth of factors. Only applies to Newton's
+         * method. Should be called before iterate_init().
+         *
+         * @param mixed_precision Whether to use mixed precision.
          */
-        std::pair<arma::mat, arma::mat> node_impedance();
+        void set_mixed_precision(bool mixed_precision)
+        {
+            mixed_precision_ = mixed_precision;
+        }
+
+        /**
+         * Add size, fill-in and number of floating-point operations of the factorized
+         * matrices to profiling report.
+         */
+        void profile_factors() const;
 
         /**
          * Initialize iteration.
          */
         void iterate_init();
 
+        /**
+         * Update power injections and voltage set point of a node, for the next snapshot.
+         *
+         * @param id Node ID (or row offset of node data, start at 1).
+         * @param v Node voltage.
+         * @param g Generator power (active).
+         * @param p Load power (active).
+         * @param q Load power (reactive).
+         */
+        void update_node(unsigned id, double v, double g, double p, double q);
+
+        /**
+         * Initialize iteration of a snapshot, after nodes are updated. Topology is unchanged,
+         * so node admittance matrix and jacobian pattern are kept, and the iteration starts
+         * from the last solution.
+         */
+        void snapshot_init();
+
         /**
          * Solve formula.
          * 
@@ -318,6 +818,12 @@ namespace flow
          */
         arma::mat result();
 
+        /**
+         * Factorize node admittance matrix modified for short circuit calculation, and
+         * solve the column of node impedance matrix corresponding to short circuit node.
+         */
+        void short_circuit_init();
+
         /**
          * Get current of three-phase short circuit.
          */
@@ -329,8 +835,122 @@ namespace flow
         arma::mat short_circuit_voltage();
 
         /**
-         * Get edge current of short circuit.
+         * Get edge current of short circuit. Current of edges out of service is zero.
          */
         arma::mat short_circuit_edge_current();
+
+        /**
+         * Calculate three-phase short circuit on each of the specified nodes, with each of the
+         * specified transition impedances. Should be called after short_circuit_init().
+         *
+         * Fault nodes are calculated block by block in parallel, and results are handed over
+         * in order, so that only one block for each thread is kept in memory.
+         *
+         * @param threads Number of threads (0 for number of hardware threads).
+         * @param func Callback for rows of each block. Each row contains ID of short circuit node,
+         *             transition impedance, short circuit current, and node voltage of all nodes
+         *             (in original node order), all complex values as real and imaginary part.
+         * @return Total number of rows.
+         */
+        template <typename F>
+        unsigned short_circuit_sweep(unsigned threads, F func) const
+        {
+            const auto n_faults = static_cast<unsigned>(short_circuit_nodes_.size());
+            const auto n_blocks = (n_faults + sweep_block_size - 1) / sweep_block_size;
+            const auto u = prefault_voltage();
+            threads = std::min(parallel::threads(threads), std::max(n_blocks, 1U));
+            std::vector<arma::mat> blocks(threads);
+            for (auto first = 0U; first < n_blocks; first += threads) {
+                const auto count = std::min(threads, n_blocks - first);
+                parallel::for_each(count, threads, [&](unsigned i, unsigned)
+                {
+                    short_circuit_block(first + i, u, blocks[i]);
+                });
+                for (auto i = 0U; i < count; ++i) {
+                    func(static_cast<const arma::mat&>(blocks[i]));
+                }
+            }
+            return n_faults * static_cast<unsigned>(z_fs_.size());
+        }
+
+        /**
+         * Solve the column of node impedance matrix for another short circuit node, with the
+         * existing factorization. Should be called after short_circuit_init().
+         *
+         * @param id Node ID (or row offset of node data, start at 1).
+         * @param z_f Transition impedance.
+         */
+        void short_circuit_fault(unsigned id, const std::complex<double>& z_f);
+
+        /**
+         * Reset node data and voltage to those of the base case, which is a copy of this one
+         * (before any change) and has converged. Node admittance matrix is unchanged.
+         *
+         * @param base Base case.
+         */
+        void reset(const calc& base);
+
+        /**
+         * Switch an edge in or out of service, or change its transformer ratio. Node admittance
+         * matrix is updated in place by the 2x2 block of the edge. Existing factorizations of B'
+         * and B'' are updated by low-rank corrections, and only refactorized after too many edges
+         * are changed. Short circuit calculation needs short_circuit_init() after solving again.
+         *
+         * @param edge Offset of edge.
+         * @param in_service Whether edge is in service.
+         * @param k Transformer ratio (0 if edge has no transformer).
+         */
+        void switch_edge(unsigned edge, bool in_service, double k);
+
+        /**
+         * Find edges whose outage splits the network into islands (bridges of the network graph).
+         *
+         * @return Whether each edge is a bridge.
+         */
+        std::vector<bool> bridges() const;
+
+        /**
+         * Solve power flow with an edge out of service.
+         *
+         * @param edge Offset of edge.
+         * @param base Base case, which provides the initial value and the original admittance.
+         * @param max Max number of iterations.
+         * @param n_iter Number of iterations done.
+         * @return Whether calculation converges.
+         */
+        bool solve_outage(unsigned edge, const calc& base, unsigned max, unsigned& n_iter);
+
+
+        /**
+         * Do N-1 contingency analysis, with each edge out of service in turn. Should be called
+         * after power flow of the base case converges, which is used as the initial value.
+         *
+         * @param max Max number of iterations for each case.
+         * @param u_min Lower limit of node voltage.
+         * @param u_max Upper limit of node voltage.
+         * @param threads Number of threads (0 for number of hardware threads).
+         * @return Each row contains edge offset (start at 1), node IDs of the edge, status
+         *         (0 - converged, 1 - not converged, 2 - islanding), number of iterations,
+         *         number of voltage violations, severity (sum of voltage violations), min
+         *         voltage and its node ID, max voltage and its node ID. Rows are ranked by
+         *         status and severity, most severe first.
+         */
+        arma::mat contingency(unsigned max, double u_min, double u_max, unsigned threads) const;
+
+        /**
+         * Get external node IDs, in original node order.
+         */
+        const std::vector<unsigned>& node_ids() const
+        {
+            return node_ids_;
+        }
+
+        /**
+         * Get number of edges.
+         */
+        unsigned num_edges() const
+        {
+            return static_cast<unsigned>(edges_.m.size());
+        }
     };
 }
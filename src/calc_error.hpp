@@ -0,0 +1,19 @@
+//
+// arma-flow/calc_error.hpp
+//
+// @author CismonX
+//
+
+#pragma once
+
+#include <stdexcept>
+
+namespace flow
+{
+    /// Error in power flow calculation, such as bad input data or a singular matrix.
+    class calc_error : public std::runtime_error
+    {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+}
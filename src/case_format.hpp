@@ -0,0 +1,128 @@
+//
+// arma-flow/case_format.hpp
+//
+// @author CismonX
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace flow
+{
+    /// Header of binary case file.
+    ///
+    /// The header is followed by sections below, each of which is 8-byte aligned and in native
+    /// byte order, so that the file can be mapped into memory and used without parsing:
+    ///
+    /// * Node table (column-major, `node_rows` x `node_cols` doubles), same as node data file.
+    /// * Edge table (column-major, `edge_rows` x `edge_cols` doubles), same as edge data file.
+    /// * (If `has_node_admittance` is set) Bus ordering (`node_rows` uint64, original node offset
+    ///   of each sorted node), then node admittance matrix in sorted node order, in compressed
+    ///   sparse column format (`node_rows` + 1 uint64 column pointers, `y_nnz` uint64 row indices
+    ///   and `y_nnz` complex doubles).
+    struct case_header
+    {
+        /// Flag indicating that first column of node table is node ID.
+        static constexpr std::uint32_t has_node_id = 1;
+
+        /// Flag indicating that node admittance matrix is included.
+        static constexpr std::uint32_t has_node_admittance = 2;
+
+        /// Current version of format.
+        static constexpr std::uint32_t current_version = 1;
+
+        /// Byte order mark, for detecting files written on a machine of different endianness.
+        static constexpr std::uint32_t byte_order_mark = 0x01020304;
+
+        /// Magic number, "ARMAFLOW".
+        char magic[8];
+
+        /// Byte order mark.
+        std::uint32_t byte_order;
+
+        /// Version of format.
+        std::uint32_t version;
+
+        /// Flags.
+        std::uint32_t flags;
+
+        /// Number of columns of node table.
+        std::uint32_t node_cols;
+
+        /// Number of rows of node table.
+        std::uint64_t node_rows;
+
+        /// Number of rows of edge table.
+        std::uint64_t edge_rows;
+
+        /// Number of columns of edge table.
+        std::uint32_t edge_cols;
+
+        /// Reserved, for alignment.
+        std::uint32_t reserved;
+
+        /// Number of non-zero elements of node admittance matrix.
+        std::uint64_t y_nnz;
+
+        /**
+         * Create a header of current version.
+         */
+        static case_header create()
+        {
+            case_header header {};
+            std::memcpy(header.magic, "ARMAFLOW", sizeof header.magic);
+            header.byte_order = byte_order_mark;
+            header.version = current_version;
+            return header;
+        }
+
+        /**
+         * Check whether header is valid and of current version.
+         */
+        bool valid() const
+        {
+            return !std::memcmp(magic, "ARMAFLOW", sizeof magic) && byte_order == byte_order_mark &&
+                version == current_version;
+        }
+
+        /**
+         * Get size of file described by this header.
+         *
+         * @param size Size of file in bytes.
+         * @return Whether size is representable (false if counts are corrupted).
+         */
+        bool file_size(std::uint64_t& size) const
+        {
+            // Counts are read from file, so that each step is checked for overflow.
+            constexpr auto max = std::numeric_limits<std::uint64_t>::max();
+            const auto add = [](std::uint64_t& sum, std::uint64_t val)
+            {
+                if (sum > max - val) {
+                    return false;
+                }
+                sum += val;
+                return true;
+            };
+            const auto add_product = [&add](std::uint64_t& sum, std::uint64_t val1, std::uint64_t val2)
+            {
+                return (!val1 || val2 <= max / val1) && add(sum, val1 * val2);
+            };
+            // Number of 8-byte elements in sections.
+            std::uint64_t elements = 0;
+            if (!add_product(elements, node_rows, node_cols) || !add_product(elements, edge_rows, edge_cols)) {
+                return false;
+            }
+            if ((flags & has_node_admittance) && (!add_product(elements, node_rows, 2) ||
+                !add(elements, 1) || !add_product(elements, y_nnz, 3))) {
+                return false;
+            }
+            size = sizeof(case_header);
+            return add_product(size, elements, 8);
+        }
+    };
+
+    static_assert(sizeof(case_header) % 8 == 0, "Sections of case file should be 8-byte aligned.");
+}
@@ -4,8 +4,14 @@
 // @author CismonX
 //
 
+#include "calc_error.hpp"
 #include "executor.hpp"
 #include "factory.hpp"
+#include "kernel.hpp"
+#include "parallel.hpp"
+#include "profiler.hpp"
+#include "reader.hpp"
+#include "server.hpp"
 #include "writer.hpp"
 
 namespace flow
@@ -13,6 +19,26 @@ namespace flow
     executor::executor() : factory_(factory::get()) {}
 
     void executor::execute(int argc, char** argv) const
+    {
+        // Parse options.
+        auto args = factory_->get_args();
+        args->parse(argc, argv);
+        if (args->profile()) {
+            profiler::enable();
+        }
+        try {
+            run();
+        }
+        catch (const calc_error& e) {
+            writer::error(e.what());
+        }
+        if (profiler::enabled()) {
+            factory_->get_calc()->profile_factors();
+            factory_->get_writer()->to_text_file("profile.json", profiler::to_json());
+        }
+    }
+
+    void executor::run() const
     {
         // Get components.
         auto args = factory_->get_args();
@@ -20,23 +46,41 @@ namespace flow
         auto calc = factory_->get_calc();
         auto writer = factory_->get_writer();
 
-        // Parse options.
-        args->parse(argc, argv);
-
         // Read data from file.
-        std::string path_to_nodes, path_to_edges;
-        if (!args->input_file_path(path_to_nodes, path_to_edges)) {
-            args->help();
-        }
+        unsigned threads;
+        args->threads(threads);
+        input->set_threads(threads);
+        writer->set_threads(threads);
+        calc->set_threads(threads);
         const auto remove = args->remove_first_line();
-        if (!input->from_csv_file(path_to_nodes, remove)) {
-            writer::error("Failed to read node data from file.");
-        }
-        const auto nodes = input->get_mat();
-        if (!input->from_csv_file(path_to_edges, remove)) {
-            writer::error("Failed to read edge data from file.");
+        auto node_id = args->node_id();
+        std::string case_path;
+        const auto from_case = args->case_file_path(case_path);
+        arma::mat csv_nodes, csv_edges;
+        if (from_case) {
+            // Tables of binary case file are used in place.
+            profiler::scope timer("read");
+            if (!input->from_case_file(case_path)) {
+                writer::error("Failed to read case file.");
+            }
+            node_id = input->case_node_id();
+        } else {
+            std::string path_to_nodes, path_to_edges;
+            if (!args->input_file_path(path_to_nodes, path_to_edges)) {
+                args->help();
+            }
+            profiler::scope timer("read");
+            if (!input->from_csv_file(path_to_nodes, remove)) {
+                writer::error("Failed to read node data from file.");
+            }
+            csv_nodes = input->take_mat();
+            if (!input->from_csv_file(path_to_edges, remove)) {
+                writer::error("Failed to read edge data from file.");
+            }
+            csv_edges = input->take_mat();
         }
-        const auto edges = input->get_mat();
+        const auto& nodes = from_case ? input->case_nodes() : csv_nodes;
+        const auto& edges = from_case ? input->case_edges() : csv_edges;
 
         // Get options.
         const auto verbose = args->verbose();
@@ -56,48 +100,370 @@ namespace flow
             writer::notice("Output file path not specified. Defaulted to result-*.csv.");
         }
         writer->set_output_path_prefix(output_path);
-        unsigned short_circuit_node;
-        const auto short_circuit = args->short_circuit(short_circuit_node);
-        std::complex<double> transition_impedance;
-        if (short_circuit && !args->transition_impedance(transition_impedance) && verbose) {
+        std::vector<unsigned> short_circuit_nodes;
+        auto short_circuit_all = false;
+        const auto short_circuit = args->short_circuit(short_circuit_nodes, short_circuit_all);
+        if (short_circuit && !short_circuit_all && short_circuit_nodes.empty()) {
+            writer::error("Invalid node ID for short circuit calculation.");
+        }
+        std::vector<std::complex<double>> transition_impedance;
+        if (!args->transition_impedance(transition_impedance) && short_circuit && verbose) {
             writer::notice("Transition impedance not specified, Defaulted to 0.");
         }
+        if (transition_impedance.empty()) {
+            writer::error("Invalid transition impedance.");
+        }
+        // Sweep mode, if short circuit is calculated on more than one node or transition impedance.
+        const auto short_circuit_sweep = short_circuit_all || short_circuit_nodes.size() > 1 ||
+            transition_impedance.size() > 1;
+        std::string snapshot_path;
+        const auto snapshots = args->snapshots(snapshot_path);
+        if (snapshots && short_circuit) {
+            writer::error("Short circuit calculation is not supported with snapshots.");
+        }
+        std::string switching_path;
+        const auto switching = args->switching(switching_path);
+        if (switching && snapshots) {
+            writer::error("Switching events are not supported with snapshots.");
+        }
+        std::string contingency_mode;
+        const auto contingency = args->contingency(contingency_mode);
+        if (contingency && contingency_mode != "n-1") {
+            writer::error("Invalid contingency analysis mode.");
+        }
+        std::string serve_path;
+        const auto serve = args->serve(serve_path);
+        if (serve && (snapshots || switching || contingency)) {
+            writer::error("Serving is not supported with snapshots, switching events or contingency analysis.");
+        }
+        auto u_min = 0.0, u_max = 0.0;
+        if (!args->voltage_limits(u_min, u_max) && contingency && verbose) {
+            writer::notice("Voltage limits not specified. Defaulted to 0.95 and 1.05.");
+        }
+        if (u_min < 0 || u_min > u_max) {
+            writer::error("Invalid voltage limits.");
+        }
         const auto ignore_load = args->ignore_load();
+        std::string method_name;
+        if (!args->method(method_name) && verbose) {
+            writer::notice("Method not specified. Defaulted to newton.");
+        }
+        auto method = calc::newton;
+        if (method_name == "polar") {
+            method = calc::polar;
+        } else if (method_name == "fdlf") {
+            method = calc::fdlf;
+        } else if (method_name != "newton") {
+            writer::error("Invalid method.");
+        }
+        std::string ordering_name;
+        args->ordering(ordering_name);
+        auto ordering_method = ordering::colamd;
+        if (ordering_name == "md") {
+            ordering_method = ordering::min_degree;
+        } else if (ordering_name == "rcm") {
+            ordering_method = ordering::rcm;
+        } else if (ordering_name != "colamd") {
+            writer::error("Invalid ordering.");
+        }
+        calc->set_ordering(ordering_method);
+        const auto mixed_precision = args->mixed_precision();
+        if (mixed_precision && method == calc::fdlf && verbose) {
+            writer::notice("Mixed precision only applies to Newton's method. Ignored.");
+        }
+        calc->set_mixed_precision(mixed_precision);
+
+        std::vector<std::string> outputs;
+        args->outputs(outputs);
+        for (auto&& name : outputs) {
+            if (name != "flow" && name != "ybus" && name != "zbus" && name != "fault") {
+                outputs.clear();
+                break;
+            }
+        }
+        if (outputs.empty()) {
+            writer::error("Invalid outputs.");
+        }
+        const auto output = [&outputs](const char* name)
+        {
+            return std::find(outputs.begin(), outputs.end(), name) != outputs.end();
+        };
+        std::string matrix_format;
+        args->matrix_format(matrix_format);
+        if (matrix_format != "csv" && matrix_format != "mm" && matrix_format != "triplet") {
+            writer::error("Invalid matrix format.");
+        }
+        // Convert input CSV files to binary case file, with precomputed node admittance matrix.
+        std::string convert_path;
+        if (args->convert(convert_path)) {
+            const auto has_x_d = nodes.n_cols == (node_id ? 7 : 6);
+            calc->init(nodes, edges, node_id, method, false, epsilon, has_x_d, ignore_load, { },
+                transition_impedance);
+            calc->admittance_init();
+            writer::to_case_file(convert_path, nodes, edges, node_id, calc->node_order(),
+                calc->sorted_node_admittance());
+            writer::println("Finished converting to case file.");
+            return;
+        }
 
         // Initialize calculation.
-        calc->init(nodes, edges, verbose, epsilon, short_circuit, ignore_load,
-            short_circuit_node, transition_impedance);
-        const auto admittance = calc->node_admittance();
-        writer->to_csv_file("node-admittance-real.csv", admittance.first);
-        writer->to_csv_file("node-admittance-imag.csv", admittance.second);
-        calc->iterate_init();
+        profiler::info("nodes", nodes.n_rows);
+        profiler::info("edges", edges.n_rows);
+        profiler::info("method", method_name);
+        profiler::info("ordering", ordering_name);
+        profiler::info("mixed_precision", mixed_precision);
+        profiler::info("threads", parallel::threads(threads));
+        profiler::info("kernel", kernel::isa_name());
+        {
+            profiler::scope timer("init");
+            calc->init(nodes, edges, node_id, method, verbose, epsilon, short_circuit, ignore_load,
+                short_circuit_nodes, transition_impedance);
+        }
+        {
+            profiler::scope timer("node_admittance");
+            arma::uvec node_order;
+            arma::sp_cx_mat n_adm;
+            if (from_case && input->case_node_admittance(node_order, n_adm) &&
+                !calc->set_node_admittance(node_order, std::move(n_adm)) && verbose) {
+                writer::notice("Node order or sparsity pattern mismatches. Precomputed node admittance matrix is ignored.");
+            }
+            calc->admittance_init();
+        }
+        // Network matrices are written as real and imaginary part in dense CSV, a complex
+        // MatrixMarket file, or CSV triplets of non-zero elements.
+        if (output("ybus")) {
+            profiler::scope timer("write_ybus");
+            const auto admittance = calc->node_admittance();
+            if (matrix_format == "mm") {
+                writer->to_mm_file("node-admittance.mtx", admittance);
+            } else if (matrix_format == "triplet") {
+                writer->to_triplet_file("node-admittance-triplet.csv", admittance, calc->node_ids());
+            } else {
+                writer->to_csv_file("node-admittance-real.csv", arma::sp_mat(arma::real(admittance)));
+                writer->to_csv_file("node-admittance-imag.csv", arma::sp_mat(arma::imag(admittance)));
+            }
+        }
+        {
+            profiler::scope timer("iterate_init");
+            calc->iterate_init();
+        }
 
-        // Do iteration.
+        // Do iteration, until converged. Returns 0 if exceeds max number of iterations.
+        const auto converge = [calc, max, epsilon]
+        {
+            unsigned num_iterations;
+            do {
+                num_iterations = calc->solve();
+                if (calc->get_max() <= epsilon) {
+                    return num_iterations;
+                }
+            } while (num_iterations < max);
+            return 0U;
+        };
         unsigned num_iterations;
-        do {
-            num_iterations = calc->solve();
-            if (calc->get_max() <= epsilon) {
-                writer::println("Finished. Total number of iterations: ", num_iterations);
-                const auto result = calc->result();
+        {
+            profiler::scope timer("flow");
+            num_iterations = converge();
+        }
+        if (!num_iterations) {
+            writer::error("Exceeds max number of iterations. Aborted.");
+        }
+        profiler::info("iterations", num_iterations);
+        writer::println("Finished. Total number of iterations: ", num_iterations);
+        arma::mat result;
+        {
+            profiler::scope timer("result");
+            result = calc->result();
+        }
+        if (verbose) {
+            writer::println("Result [V, theta(in rads), P, Q]:");
+            writer::print_mat(result);
+        }
+        if (output("flow")) {
+            profiler::scope timer("write_flow");
+            writer->to_csv_file("flow.csv", result, "V,theta,P,Q");
+        }
+
+        // Serve what-if requests on the converged base case, until stopped by signal.
+        if (serve) {
+            if (short_circuit) {
+                profiler::scope timer("short_circuit_init");
+                calc->short_circuit_init();
+            }
+            server srv(*calc, max, epsilon, short_circuit);
+            if (!srv.run(serve_path)) {
+                writer::error("Failed to serve on socket.");
+            }
+            return;
+        }
+
+        // N-1 contingency analysis, with the converged base case as initial value.
+        if (contingency) {
+            profiler::scope timer("contingency");
+            const auto report = calc->contingency(max, u_min, u_max, threads);
+            writer->to_csv_file("contingency.csv", report,
+                "edge,n1,n2,status,iterations,violations,severity,Umin,Umin_node,Umax,Umax_node");
+            writer::println("Finished N-1 contingency analysis. Total number of cases: ", report.n_rows);
+        }
+
+        // Time series calculation. Each snapshot starts from the solution of the last one.
+        if (snapshots) {
+            profiler::scope timer("time_series");
+            writer->open_stream("time-series.csv", "snapshot,node,V,theta,P,Q");
+            const auto& node_ids = calc->node_ids();
+            auto num_snapshots = 0U;
+            const auto solve_snapshot = [&](double snapshot)
+            {
+                calc->snapshot_init();
+                const auto num_iterations = converge();
+                if (!num_iterations) {
+                    writer::error("Exceeds max number of iterations in snapshot ", snapshot, ". Aborted.");
+                }
                 if (verbose) {
-                    writer::println("Result [V, theta(in rads), P, Q]:");
-                    writer::print_mat(result);
+                    writer::println("Finished snapshot ", snapshot, ". Total number of iterations: ", num_iterations);
+                }
+                const auto result = calc->result();
+                arma::mat prefix(result.n_rows, 2);
+                for (auto row = 0U; row < result.n_rows; ++row) {
+                    prefix.at(row, 0) = snapshot;
+                    prefix.at(row, 1) = node_ids[row];
+                }
+                writer->append_to_stream(join_rows(prefix, result));
+                ++num_snapshots;
+            };
+            std::vector<std::string> files;
+            if (reader::list_directory(snapshot_path, files)) {
+                // Each file in the directory is a node data file, with the same format as the base case.
+                const auto id_cols = node_id ? 1U : 0U;
+                for (auto&& file : files) {
+                    if (!input->from_csv_file(file, remove)) {
+                        writer::error("Failed to read snapshot from file.");
+                    }
+                    const auto& snapshot = input->get_mat();
+                    if (snapshot.n_cols != nodes.n_cols) {
+                        writer::error("Bad snapshot format.");
+                    }
+                    for (auto row = 0U; row < snapshot.n_rows; ++row) {
+                        const auto id = node_id ? static_cast<unsigned>(snapshot.at(row, 0)) : row + 1;
+                        calc->update_node(id, snapshot.at(row, id_cols), snapshot.at(row, id_cols + 1),
+                            snapshot.at(row, id_cols + 2), snapshot.at(row, id_cols + 3));
+                    }
+                    solve_snapshot(num_snapshots + 1);
+                }
+            } else {
+                // Long-format CSV file. Rows of the same snapshot should be contiguous.
+                if (!input->from_csv_file(snapshot_path, remove)) {
+                    writer::error("Failed to read snapshots from file.");
+                }
+                const auto& snapshot = input->get_mat();
+                if (snapshot.n_cols != 6) {
+                    writer::error("Bad snapshot format.");
+                }
+                for (auto row = 0U; row < snapshot.n_rows; ++row) {
+                    calc->update_node(static_cast<unsigned>(snapshot.at(row, 1)), snapshot.at(row, 2),
+                        snapshot.at(row, 3), snapshot.at(row, 4), snapshot.at(row, 5));
+                    if (row + 1 == snapshot.n_rows || snapshot.at(row + 1, 0) != snapshot.at(row, 0)) {
+                        solve_snapshot(snapshot.at(row, 0));
+                    }
                 }
-                writer->to_csv_file("flow.csv", result, "V,theta,P,Q");
-                goto flow_done;
             }
-        } while (num_iterations < max);
-        writer::error("Exceeds max number of iterations. Aborted.");
+            writer->close_stream();
+            writer::println("Finished time series calculation. Total number of snapshots: ", num_snapshots);
+        }
 
-        flow_done:
+        // Switching events. Edges are changed in place, and each event starts from the solution
+        // of the last one.
+        if (switching) {
+            profiler::scope timer("switching");
+            if (!input->from_csv_file(switching_path, remove)) {
+                writer::error("Failed to read switching events from file.");
+            }
+            const auto& events = input->get_mat();
+            if (events.n_cols != 4) {
+                writer::error("Bad switching event format.");
+            }
+            writer->open_stream("switching.csv", "event,node,V,theta,P,Q");
+            const auto& node_ids = calc->node_ids();
+            auto num_events = 0U;
+            for (auto row = 0U; row < events.n_rows; ++row) {
+                const auto event = events.at(row, 0);
+                const auto edge = static_cast<unsigned>(events.at(row, 1));
+                const auto in_service = events.at(row, 2) != 0;
+                if (edge < 1 || edge > calc->num_edges()) {
+                    writer::error("Bad edge offset in switching event ", event, ".");
+                }
+                if (!in_service && calc->bridges()[edge - 1]) {
+                    writer::error("Switching event ", event, " splits the network into islands. Aborted.");
+                }
+                calc->switch_edge(edge - 1, in_service, events.at(row, 3));
+                if (row + 1 < events.n_rows && events.at(row + 1, 0) == event) {
+                    continue;
+                }
+                calc->snapshot_init();
+                const auto num_iterations = converge();
+                if (!num_iterations) {
+                    writer::error("Exceeds max number of iterations in switching event ", event, ". Aborted.");
+                }
+                if (verbose) {
+                    writer::println("Finished switching event ", event, ". Total number of iterations: ", num_iterations);
+                }
+                const auto result = calc->result();
+                arma::mat prefix(result.n_rows, 2);
+                for (auto node = 0U; node < result.n_rows; ++node) {
+                    prefix.at(node, 0) = event;
+                    prefix.at(node, 1) = node_ids[node];
+                }
+                writer->append_to_stream(join_rows(prefix, result));
+                ++num_events;
+            }
+            writer->close_stream();
+            writer::println("Finished switching events. Total number of events: ", num_events);
+        }
 
         // Calculate three-phase short circuit.
         if (!short_circuit) {
             return;
         }
-        const auto impedance = calc->node_impedance();
-        writer->to_csv_file("node-impedance-real.csv", impedance.first);
-        writer->to_csv_file("node-impedance-imag.csv", impedance.second);
+        {
+            profiler::scope timer("short_circuit_init");
+            calc->short_circuit_init();
+        }
+        if (output("zbus") || args->node_impedance()) {
+            profiler::scope timer("node_impedance");
+            const auto impedance = calc->node_impedance();
+            if (matrix_format == "mm") {
+                writer->to_mm_file("node-impedance.mtx", impedance);
+            } else if (matrix_format == "triplet") {
+                writer->to_triplet_file("node-impedance-triplet.csv", arma::sp_cx_mat(impedance), calc->node_ids());
+            } else {
+                writer->to_csv_file("node-impedance-real.csv", arma::mat(arma::real(impedance)));
+                writer->to_csv_file("node-impedance-imag.csv", arma::mat(arma::imag(impedance)));
+            }
+        }
+        if (!output("fault")) {
+            if (!short_circuit_sweep) {
+                writer::print_complex("Three-phase short circuit current: ", calc->short_circuit_current());
+            }
+            return;
+        }
+        if (short_circuit_sweep) {
+            profiler::scope timer("short_circuit_sweep");
+            std::string header = "node,Zf(real),Zf(imag),If(real),If(imag)";
+            for (auto&& id : calc->node_ids()) {
+                const auto id_str = std::to_string(id);
+                header += ",U" + id_str + "(real),U" + id_str + "(imag)";
+            }
+            // Rows are streamed block by block, as the whole result is quadratic in network size.
+            writer->open_stream("short-circuit-sweep.csv", header);
+            const auto num_cases = calc->short_circuit_sweep(threads, [writer](const arma::mat& rows)
+            {
+                writer->append_to_stream(rows);
+            });
+            writer->close_stream();
+            writer::println("Finished three-phase short circuit calculation. Total number of cases: ", num_cases);
+            return;
+        }
+        profiler::scope timer("short_circuit");
         const auto i_f = calc->short_circuit_current();
         writer::print_complex("Three-phase short circuit current: ", i_f);
         const auto u_f = calc->short_circuit_voltage();
@@ -17,6 +17,11 @@ namespace flow
         /// The factory instance.
         factory* factory_;
 
+        /**
+         * Read input, do calculation and write results.
+         */
+        void run() const;
+
     public:
         /**
          * Default constructor.
@@ -0,0 +1,137 @@
+//
+// arma-flow/kernel.cpp
+//
+// @author CismonX
+//
+
+#include "kernel.hpp"
+
+#include <cstdlib>
+#include <string>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FLOW_KERNEL_X86
+#include <immintrin.h>
+#endif // __x86_64__
+
+namespace flow
+{
+    namespace
+    {
+        void spmv_scalar(const kernel::split_csr& a, const double* e, const double* f, unsigned first,
+            unsigned last, std::complex<double>* y)
+        {
+            for (auto row = first; row < last; ++row) {
+                auto sum_re = 0.0, sum_im = 0.0;
+                for (auto k = a.row_ptrs[row]; k < a.row_ptrs[row + 1]; ++k) {
+                    const auto col = a.col_indices[k];
+                    sum_re += a.real[k] * e[col] - a.imag[k] * f[col];
+                    sum_im += a.real[k] * f[col] + a.imag[k] * e[col];
+                }
+                y[row] = { sum_re, sum_im };
+            }
+        }
+
+#ifdef FLOW_KERNEL_X86
+        __attribute__((target("avx2,fma")))
+        double hsum_avx2(__m256d v)
+        {
+            auto sum = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+            return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+        }
+
+        __attribute__((target("avx2,fma")))
+        void spmv_avx2(const kernel::split_csr& a, const double* e, const double* f, unsigned first,
+            unsigned last, std::complex<double>* y)
+        {
+            const auto lanes = _mm256_setr_epi64x(0, 1, 2, 3);
+            const auto lanes_32 = _mm_setr_epi32(0, 1, 2, 3);
+            for (auto row = first; row < last; ++row) {
+                auto acc_re = _mm256_setzero_pd(), acc_im = _mm256_setzero_pd();
+                // Four elements at a time, with voltage gathered by column indices. The remainder
+                // is masked, so that rows of a few elements (which are typical for power networks)
+                // take a single step.
+                for (auto k = a.row_ptrs[row]; k < a.row_ptrs[row + 1]; k += 4) {
+                    const auto n = static_cast<int>(a.row_ptrs[row + 1] - k);
+                    const auto mask = _mm256_castsi256_pd(_mm256_cmpgt_epi64(_mm256_set1_epi64x(n), lanes));
+                    const auto cols = _mm_maskload_epi32(reinterpret_cast<const int*>(a.col_indices + k),
+                        _mm_cmpgt_epi32(_mm_set1_epi32(n), lanes_32));
+                    const auto g = _mm256_maskload_pd(a.real + k, _mm256_castpd_si256(mask));
+                    const auto b = _mm256_maskload_pd(a.imag + k, _mm256_castpd_si256(mask));
+                    const auto e_k = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), e, cols, mask, 8);
+                    const auto f_k = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), f, cols, mask, 8);
+                    acc_re = _mm256_fnmadd_pd(b, f_k, _mm256_fmadd_pd(g, e_k, acc_re));
+                    acc_im = _mm256_fmadd_pd(b, e_k, _mm256_fmadd_pd(g, f_k, acc_im));
+                }
+                y[row] = { hsum_avx2(acc_re), hsum_avx2(acc_im) };
+            }
+        }
+
+        __attribute__((target("avx512f,avx512vl")))
+        double hsum_avx512(__m512d v)
+        {
+            alignas(64) double lanes[8];
+            _mm512_store_pd(lanes, v);
+            return ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5])) + ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+        }
+
+        __attribute__((target("avx512f,avx512vl")))
+        void spmv_avx512(const kernel::split_csr& a, const double* e, const double* f, unsigned first,
+            unsigned last, std::complex<double>* y)
+        {
+            for (auto row = first; row < last; ++row) {
+                auto acc_re = _mm512_setzero_pd(), acc_im = _mm512_setzero_pd();
+                // Eight elements at a time. The remainder is masked, so that rows of a few
+                // elements (which are typical for power networks) take a single step.
+                for (auto k = a.row_ptrs[row]; k < a.row_ptrs[row + 1]; k += 8) {
+                    const auto n = a.row_ptrs[row + 1] - k;
+                    const auto mask = static_cast<__mmask8>(n >= 8 ? 0xff : (1U << n) - 1);
+                    const auto cols = _mm256_maskz_loadu_epi32(mask, a.col_indices + k);
+                    const auto g = _mm512_maskz_loadu_pd(mask, a.real + k);
+                    const auto b = _mm512_maskz_loadu_pd(mask, a.imag + k);
+                    const auto e_k = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), mask, cols, e, 8);
+                    const auto f_k = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), mask, cols, f, 8);
+                    acc_re = _mm512_fnmadd_pd(b, f_k, _mm512_fmadd_pd(g, e_k, acc_re));
+                    acc_im = _mm512_fmadd_pd(b, e_k, _mm512_fmadd_pd(g, f_k, acc_im));
+                }
+                y[row] = { hsum_avx512(acc_re), hsum_avx512(acc_im) };
+            }
+        }
+#endif // FLOW_KERNEL_X86
+    }
+
+    const kernel::dispatch& kernel::get()
+    {
+        static const auto selected = []
+        {
+            // Instruction set can be limited by environment variable (e.g. for regression checks).
+            const auto env = std::getenv("ARMA_FLOW_KERNEL");
+            const std::string limit = env ? env : "";
+#ifdef FLOW_KERNEL_X86
+            __builtin_cpu_init();
+            if ((limit.empty() || limit == "avx512") &&
+                __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")) {
+                return dispatch { avx512, spmv_avx512 };
+            }
+            if ((limit.empty() || limit == "avx512" || limit == "avx2") &&
+                __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+                return dispatch { avx2, spmv_avx2 };
+            }
+#endif // FLOW_KERNEL_X86
+            return dispatch { scalar, spmv_scalar };
+        }();
+        return selected;
+    }
+
+    const char* kernel::isa_name()
+    {
+        switch (isa()) {
+            case avx512:
+                return "avx512";
+            case avx2:
+                return "avx2";
+            default:
+                return "scalar";
+        }
+    }
+}
@@ -0,0 +1,92 @@
+//
+// arma-flow/kernel.hpp
+//
+// @author CismonX
+//
+
+#pragma once
+
+#include <complex>
+#include <cstdint>
+
+namespace flow
+{
+    /// Vectorized kernels of power flow calculation. The implementation is selected at runtime
+    /// by CPU features (AVX-512F with VL, AVX2 with FMA, or scalar fallback), and can be limited
+    /// by environment variable ARMA_FLOW_KERNEL (`avx512`, `avx2` or `scalar`).
+    class kernel
+    {
+    public:
+        /// Instruction set of kernels.
+        enum isa_type {
+            scalar, avx2, avx512
+        };
+
+        /// Sparse matrix in compressed sparse row format, with values split into real and
+        /// imaginary parts, so that they can be loaded into vectors directly.
+        struct split_csr
+        {
+            /// Row pointers.
+            const std::uint32_t* row_ptrs;
+
+            /// Column indices.
+            const std::uint32_t* col_indices;
+
+            /// Real and imaginary part of non-zero elements.
+            const double* real;
+            const double* imag;
+        };
+
+    private:
+        /// Signature of matrix-vector product kernel.
+        using spmv_func = void (*)(const split_csr&, const double*, const double*, unsigned, unsigned,
+            std::complex<double>*);
+
+        /// Kernels selected by CPU features.
+        struct dispatch
+        {
+            /// Instruction set in use.
+            isa_type isa;
+
+            /// Matrix-vector product kernel.
+            spmv_func spmv;
+        };
+
+        /**
+         * Get kernels for the current CPU, which are selected on the first call.
+         */
+        static const dispatch& get();
+
+    public:
+        /**
+         * Compute y = A * x for a range of rows, where x = e + j * f. Results of the same
+         * row do not depend on other rows, while they may differ in rounding between
+         * instruction sets.
+         *
+         * @param a Matrix.
+         * @param e Real part of x.
+         * @param f Imaginary part of x.
+         * @param first First row.
+         * @param last Row after the last one.
+         * @param y Result (indexed by row).
+         */
+        static void spmv(const split_csr& a, const double* e, const double* f, unsigned first,
+            unsigned last, std::complex<double>* y)
+        {
+            get().spmv(a, e, f, first, last, y);
+        }
+
+        /**
+         * Get instruction set in use.
+         */
+        static isa_type isa()
+        {
+            return get().isa;
+        }
+
+        /**
+         * Get name of instruction set in use.
+         */
+        static const char* isa_name();
+    };
+}
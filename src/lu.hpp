@@ -0,0 +1,265 @@
+//
+// arma-flow/lu.hpp
+//
+// @author CismonX
+//
+
+#pragma once
+
+#include <armadillo>
+#include <memory>
+#include <vector>
+
+namespace flow
+{
+    /// Sparse LU factorization which reuses symbolic analysis (using SuperLU).
+    /// Instantiated for real (float and double) and complex (std::complex<double>) matrices.
+    template <typename T>
+    class lu
+    {
+        /// Factors and workspace of SuperLU (opaque, so that SuperLU headers are not exposed).
+        struct factors;
+
+        /// Factors of last factorization.
+        std::unique_ptr<factors> factors_;
+
+        /// Order of the matrix.
+        unsigned n_ = 0;
+
+        /// Sparsity pattern of the matrix (compressed sparse column).
+        std::vector<int> col_ptrs_, row_indices_;
+
+        /// Column permutation and column elimination tree, computed once for each pattern.
+        std::vector<int> perm_c_, etree_;
+
+        /// Row permutation (partial pivoting).
+        std::vector<int> perm_r_;
+
+        /// Column permutation given by caller (empty if ordered by COLAMD).
+        std::vector<int> ordering_;
+
+        /// Whether ordering is changed after the last symbolic analysis.
+        bool reorder_ = false;
+
+        /// Number of non-zero elements in factors L and U (excluding unit diagonal of L).
+        std::size_t nnz_factors_ = 0;
+
+        /// Number of floating-point operations of last factorization.
+        double flops_ = 0;
+
+        /// Whether matrix is factorized.
+        bool factorized_ = false;
+
+        /// Whether symbolic analysis of last factorization was reused.
+        bool reused_ = false;
+
+        /// Rows (and columns) modified after the last factorization.
+        arma::uvec update_rows_;
+
+        /// Accumulated modification D of the factorized matrix A, so that the current
+        /// matrix is A + E * D * E^T, where E selects the modified rows.
+        arma::Mat<T> update_delta_;
+
+        /// A^-1 * E, solved with the factors of A.
+        arma::Mat<T> update_w_;
+
+        /// D * (I + E^T * A^-1 * E * D)^-1, for the Sherman-Morrison-Woodbury correction.
+        arma::Mat<T> update_m_;
+
+        /**
+         * Check whether the given pattern is the same as the analyzed one.
+         *
+         * @param n Order of the matrix.
+         * @param col_ptrs Column pointers.
+         * @param row_indices Row indices.
+         * @return Whether pattern is unchanged.
+         */
+        bool same_pattern(unsigned n, const arma::uword* col_ptrs, const arma::uword* row_indices) const;
+
+        /**
+         * Release factors of last factorization.
+         */
+        void release();
+
+        /**
+         * Solve A * X = B with the factors of last factorization, ignoring updates.
+         *
+         * @param b Right hand side (column-major), which will be overwritten with the solution.
+         * @param n_rhs Number of right hand side columns.
+         * @return Whether solve is successful.
+         */
+        bool solve_factors(T* b, unsigned n_rhs) const;
+
+        /**
+         * Solve A * X = B with the last factorization and updates since then.
+         *
+         * @param b Right hand side (column-major), which will be overwritten with the solution.
+         * @param n_rhs Number of right hand side columns.
+         * @return Whether solve is successful.
+         */
+        bool do_solve(T* b, unsigned n_rhs) const;
+
+    public:
+        /// Max number of modified rows, beyond which the matrix should be refactorized,
+        /// as each solve costs an extra O(n * rank).
+        static constexpr unsigned max_rank = 32;
+
+        /**
+         * Default constructor.
+         */
+        explicit lu();
+
+        /**
+         * Destructor.
+         */
+        ~lu();
+
+        /**
+         * Copy constructor. Symbolic analysis is copied, while factors (and updates) are not,
+         * so that the copy should be factorized before solving.
+         */
+        lu(const lu& other);
+
+        lu& operator=(const lu&) = delete;
+
+        /**
+         * Set column ordering for subsequent symbolic analysis, instead of COLAMD. Symbolic
+         * analysis of the last factorization is still reused if ordering is unchanged.
+         *
+         * @param order Column offsets in elimination order (empty to use COLAMD).
+         * @param symmetric Whether the matrix is symmetric in value (not only in pattern), so that
+         *                  diagonal elements are preferred as pivots, which keeps the ordering of
+         *                  rows as well. Otherwise, rows are ordered by partial pivoting.
+         */
+        void set_ordering(const std::vector<unsigned>& order, bool symmetric);
+
+        /**
+         * Factorize a sparse matrix in compressed sparse column format. Column ordering
+         * and symbolic analysis are done only if the sparsity pattern differs from the
+         * last factorized one. Updates of the last factorization are discarded.
+         *
+         * @param n Order of the matrix.
+         * @param col_ptrs Column pointers.
+         * @param row_indices Row indices.
+         * @param values Non-zero elements.
+         * @return Whether factorization is successful (false if matrix is singular).
+         */
+        bool factorize(unsigned n, const arma::uword* col_ptrs, const arma::uword* row_indices, const T* values);
+
+        /**
+         * Factorize a sparse matrix in compressed sparse column format.
+         *
+         * @param n Order of the matrix.
+         * @param col_ptrs Column pointers.
+         * @param row_indices Row indices.
+         * @param values Non-zero elements.
+         * @return Whether factorization is successful.
+         */
+        bool factorize(
+            unsigned              n,
+            const arma::uvec&     col_ptrs,
+            const arma::uvec&     row_indices,
+            const arma::Col<T>&   values)
+        {
+            return factorize(n, col_ptrs.memptr(), row_indices.memptr(), values.memptr());
+        }
+
+        /**
+         * Factorize a sparse matrix.
+         *
+         * @param mat Matrix to be factorized (should be square).
+         * @return Whether factorization is successful.
+         */
+        bool factorize(const arma::SpMat<T>& mat)
+        {
+            return factorize(mat.n_cols, mat.col_ptrs, mat.row_indices, mat.values);
+        }
+
+        /**
+         * Modify the factorized matrix in a few rows and columns, without refactorizing.
+         * Subsequent solves apply the Sherman-Morrison-Woodbury formula with the existing
+         * factors, which costs a solve for each newly modified row.
+         *
+         * @param rows Distinct offsets of modified rows (and columns).
+         * @param delta Modification of the submatrix of given rows and columns.
+         * @return Whether update is successful (false if not factorized, if the modified matrix
+         *         is singular, or if max_rank is exceeded), otherwise updates are unchanged.
+         */
+        bool update(const arma::uvec& rows, const arma::Mat<T>& delta);
+
+        /**
+         * Discard updates since the last factorization.
+         */
+        void revert();
+
+        /**
+         * Solve A * x = b with the last factorization. Can be called concurrently.
+         *
+         * @param b Right hand side, which will be overwritten with the solution.
+         * @return Whether solve is successful.
+         */
+        bool solve(arma::Col<T>& b) const
+        {
+            return b.n_elem == n_ && do_solve(b.memptr(), 1);
+        }
+
+        /**
+         * Solve A * X = B with the last factorization. Can be called concurrently.
+         *
+         * @param b Right hand side, which will be overwritten with the solution.
+         * @return Whether solve is successful.
+         */
+        bool solve(arma::Mat<T>& b) const
+        {
+            return b.n_rows == n_ && do_solve(b.memptr(), b.n_cols);
+        }
+
+        /**
+         * Check whether matrix is factorized.
+         */
+        bool factorized() const
+        {
+            return factorized_;
+        }
+
+        /**
+         * Get number of rows modified since the last factorization.
+         */
+        unsigned rank() const
+        {
+            return update_rows_.n_elem;
+        }
+
+        /**
+         * Get number of non-zero elements of the analyzed matrix.
+         */
+        std::size_t nnz() const
+        {
+            return row_indices_.size();
+        }
+
+        /**
+         * Get number of non-zero elements in factors of last factorization.
+         */
+        std::size_t nnz_factors() const
+        {
+            return nnz_factors_;
+        }
+
+        /**
+         * Get number of floating-point operations of last factorization.
+         */
+        double flops() const
+        {
+            return flops_;
+        }
+
+        /**
+         * Check whether symbolic analysis of last factorization was reused.
+         */
+        bool reused() const
+        {
+            return reused_;
+        }
+    };
+}
@@ -0,0 +1,46 @@
+//
+// arma-flow/lu_complex.cpp
+//
+// @author CismonX
+//
+
+// Only the SuperLU header of this element type, see lu_impl.hpp.
+#include <superlu/slu_zdefs.h>
+
+#include "lu_impl.hpp"
+
+namespace flow
+{
+    namespace
+    {
+        template <>
+        struct superlu<std::complex<double>>
+        {
+            static void create_comp_col(SuperMatrix* a, int n, int nnz, std::complex<double>* values, int* row_indices, int* col_ptrs)
+            {
+                // std::complex<double> has the same layout as doublecomplex.
+                zCreate_CompCol_Matrix(a, n, n, nnz, reinterpret_cast<doublecomplex*>(values),
+                    row_indices, col_ptrs, SLU_NC, SLU_Z, SLU_GE);
+            }
+
+            static void create_dense(SuperMatrix* b, int n, int n_rhs, std::complex<double>* values)
+            {
+                zCreate_Dense_Matrix(b, n, n_rhs, reinterpret_cast<doublecomplex*>(values), n, SLU_DN, SLU_Z, SLU_GE);
+            }
+
+            template <typename ...Args>
+            static void gstrf(Args... args)
+            {
+                zgstrf(args...);
+            }
+
+            template <typename ...Args>
+            static void gstrs(Args... args)
+            {
+                zgstrs(args...);
+            }
+        };
+    }
+
+    template class lu<std::complex<double>>;
+}
@@ -0,0 +1,44 @@
+//
+// arma-flow/lu_double.cpp
+//
+// @author CismonX
+//
+
+// Only the SuperLU header of this element type, see lu_impl.hpp.
+#include <superlu/slu_ddefs.h>
+
+#include "lu_impl.hpp"
+
+namespace flow
+{
+    namespace
+    {
+        template <>
+        struct superlu<double>
+        {
+            static void create_comp_col(SuperMatrix* a, int n, int nnz, double* values, int* row_indices, int* col_ptrs)
+            {
+                dCreate_CompCol_Matrix(a, n, n, nnz, values, row_indices, col_ptrs, SLU_NC, SLU_D, SLU_GE);
+            }
+
+            static void create_dense(SuperMatrix* b, int n, int n_rhs, double* values)
+            {
+                dCreate_Dense_Matrix(b, n, n_rhs, values, n, SLU_DN, SLU_D, SLU_GE);
+            }
+
+            template <typename ...Args>
+            static void gstrf(Args... args)
+            {
+                dgstrf(args...);
+            }
+
+            template <typename ...Args>
+            static void gstrs(Args... args)
+            {
+                dgstrs(args...);
+            }
+        };
+    }
+
+    template class lu<double>;
+}
@@ -0,0 +1,44 @@
+//
+// arma-flow/lu_float.cpp
+//
+// @author CismonX
+//
+
+// Only the SuperLU header of this element type, see lu_impl.hpp.
+#include <superlu/slu_sdefs.h>
+
+#include "lu_impl.hpp"
+
+namespace flow
+{
+    namespace
+    {
+        template <>
+        struct superlu<float>
+        {
+            static void create_comp_col(SuperMatrix* a, int n, int nnz, float* values, int* row_indices, int* col_ptrs)
+            {
+                sCreate_CompCol_Matrix(a, n, n, nnz, values, row_indices, col_ptrs, SLU_NC, SLU_S, SLU_GE);
+            }
+
+            static void create_dense(SuperMatrix* b, int n, int n_rhs, float* values)
+            {
+                sCreate_Dense_Matrix(b, n, n_rhs, values, n, SLU_DN, SLU_S, SLU_GE);
+            }
+
+            template <typename ...Args>
+            static void gstrf(Args... args)
+            {
+                sgstrf(args...);
+            }
+
+            template <typename ...Args>
+            static void gstrs(Args... args)
+            {
+                sgstrs(args...);
+            }
+        };
+    }
+
+    template class lu<float>;
+}
@@ -0,0 +1,282 @@
+//
+// arma-flow/lu_impl.hpp
+//
+// @author CismonX
+//
+
+#pragma once
+
+#include "lu.hpp"
+
+#include <limits>
+#include <utility>
+
+// Implementation of lu<T>, which is included by the source file of each element type, after the
+// SuperLU header of that type. SuperLU headers of different types cannot be included together,
+// as each of them defines its own GlobalLU_t.
+
+namespace flow
+{
+    namespace
+    {
+        /// Type-specific routines of SuperLU, specialized by the source file of each element type.
+        template <typename T>
+        struct superlu;
+    }
+
+    template <typename T>
+    struct lu<T>::factors
+    {
+        /// Options of SuperLU.
+        superlu_options_t options;
+
+        /// Statistics of SuperLU.
+        SuperLUStat_t stat;
+
+        /// Global data structure of SuperLU.
+        GlobalLU_t glu;
+
+        /// Factors L and U.
+        SuperMatrix l, u;
+    };
+
+    namespace
+    {
+        /// Threshold of diagonal pivots relative to the largest element of column, for matrices
+        /// symmetric in value. Node admittance matrix, B' and B'' have their largest elements on
+        /// (or near) the diagonal, as each diagonal element sums up the elements of its row.
+        constexpr auto symmetric_pivot_threshold = 0.01;
+    }
+
+    template <typename T>
+    lu<T>::lu() : factors_(new factors)
+    {
+        set_default_options(&factors_->options);
+        factors_->options.ColPerm = COLAMD;
+        StatInit(&factors_->stat);
+    }
+
+    template <typename T>
+    lu<T>::lu(const lu& other) : lu()
+    {
+        n_ = other.n_;
+        col_ptrs_ = other.col_ptrs_;
+        row_indices_ = other.row_indices_;
+        perm_c_ = other.perm_c_;
+        etree_ = other.etree_;
+        perm_r_ = other.perm_r_;
+        ordering_ = other.ordering_;
+        reorder_ = other.reorder_;
+        factors_->options.SymmetricMode = other.factors_->options.SymmetricMode;
+        factors_->options.DiagPivotThresh = other.factors_->options.DiagPivotThresh;
+        nnz_factors_ = other.nnz_factors_;
+        flops_ = other.flops_;
+    }
+
+    template <typename T>
+    lu<T>::~lu()
+    {
+        release();
+        StatFree(&factors_->stat);
+    }
+
+    template <typename T>
+    bool lu<T>::same_pattern(unsigned n, const arma::uword* col_ptrs, const arma::uword* row_indices) const
+    {
+        if (n != n_ || col_ptrs_.size() != n + 1 || col_ptrs[n] != row_indices_.size()) {
+            return false;
+        }
+        for (auto i = 0U; i <= n; ++i) {
+            if (col_ptrs[i] != static_cast<arma::uword>(col_ptrs_[i])) {
+                return false;
+            }
+        }
+        for (auto i = 0U; i < row_indices_.size(); ++i) {
+            if (row_indices[i] != static_cast<arma::uword>(row_indices_[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <typename T>
+    void lu<T>::release()
+    {
+        revert();
+        if (factorized_) {
+            Destroy_SuperNode_Matrix(&factors_->l);
+            Destroy_CompCol_Matrix(&factors_->u);
+            factorized_ = false;
+        }
+    }
+
+    template <typename T>
+    void lu<T>::set_ordering(const std::vector<unsigned>& order, bool symmetric)
+    {
+        // SuperLU takes the position of each column after permutation.
+        std::vector<int> ordering(order.size());
+        for (auto i = 0U; i < order.size(); ++i) {
+            ordering[order[i]] = i;
+        }
+        auto& options = factors_->options;
+        const auto symmetric_mode = (symmetric && !order.empty()) ? YES : NO;
+        // Symbolic analysis is kept if nothing changes (e.g. when iteration is restarted on the
+        // same topology), and otherwise redone by the next factorization.
+        if (ordering == ordering_ && options.SymmetricMode == symmetric_mode) {
+            return;
+        }
+        ordering_ = std::move(ordering);
+        options.SymmetricMode = symmetric_mode;
+        options.DiagPivotThresh = symmetric_mode == YES ? symmetric_pivot_threshold : 1.0;
+        reorder_ = true;
+    }
+
+    template <typename T>
+    bool lu<T>::factorize(unsigned n, const arma::uword* col_ptrs, const arma::uword* row_indices, const T* values)
+    {
+        release();
+        reused_ = !reorder_ && same_pattern(n, col_ptrs, row_indices);
+        if (!reused_) {
+            reorder_ = false;
+            n_ = n;
+            col_ptrs_.assign(col_ptrs, col_ptrs + n + 1);
+            row_indices_.assign(row_indices, row_indices + col_ptrs[n]);
+            perm_c_.resize(n);
+            perm_r_.resize(n);
+            etree_.resize(n);
+        }
+        auto& options = factors_->options;
+        SuperMatrix a, a_c;
+        // Values are not modified by SuperLU, as equilibration is not enabled.
+        superlu<T>::create_comp_col(&a, n, row_indices_.size(), const_cast<T*>(values),
+            row_indices_.data(), col_ptrs_.data());
+        if (reused_) {
+            // Column permutation and elimination tree are reused.
+            options.Fact = SamePattern;
+        } else {
+            options.Fact = DOFACT;
+            if (ordering_.size() == n) {
+                perm_c_ = ordering_;
+            } else {
+                get_perm_c(options.ColPerm, &a, perm_c_.data());
+            }
+        }
+        sp_preorder(&options, &a, perm_c_.data(), etree_.data(), &a_c);
+        const auto flops = factors_->stat.ops[FACT];
+        int info;
+        superlu<T>::gstrf(&options, &a_c, sp_ienv(2), sp_ienv(1), etree_.data(), nullptr, 0,
+            perm_c_.data(), perm_r_.data(), &factors_->l, &factors_->u, &factors_->glu,
+            &factors_->stat, &info);
+        Destroy_CompCol_Permuted(&a_c);
+        Destroy_SuperMatrix_Store(&a);
+        if (info) {
+            // Factors are still allocated if matrix is singular, but not if out of memory.
+            if (info > 0 && static_cast<unsigned>(info) <= n) {
+                factorized_ = true;
+                release();
+            }
+            // Symbolic analysis should be redone next time.
+            n_ = 0;
+            col_ptrs_.clear();
+            return false;
+        }
+        factorized_ = true;
+        nnz_factors_ = static_cast<SCformat*>(factors_->l.Store)->nnz +
+            static_cast<NCformat*>(factors_->u.Store)->nnz - n;
+        flops_ = factors_->stat.ops[FACT] - flops;
+        return true;
+    }
+
+    template <typename T>
+    bool lu<T>::solve_factors(T* b, unsigned n_rhs) const
+    {
+        if (!factorized_) {
+            return false;
+        }
+        SuperMatrix b_mat;
+        superlu<T>::create_dense(&b_mat, n_, n_rhs, b);
+        // Factors are only read while solving. Statistics are kept local, so that
+        // concurrent solves do not race.
+        SuperLUStat_t stat;
+        StatInit(&stat);
+        int info;
+        superlu<T>::gstrs(NOTRANS, &factors_->l, &factors_->u, const_cast<int*>(perm_c_.data()),
+            const_cast<int*>(perm_r_.data()), &b_mat, &stat, &info);
+        StatFree(&stat);
+        Destroy_SuperMatrix_Store(&b_mat);
+        return !info;
+    }
+
+    template <typename T>
+    bool lu<T>::do_solve(T* b, unsigned n_rhs) const
+    {
+        if (!solve_factors(b, n_rhs)) {
+            return false;
+        }
+        if (update_rows_.is_empty()) {
+            return true;
+        }
+        // (A + E * D * E^T)^-1 * B = X - W * M * E^T * X, where X = A^-1 * B.
+        arma::Mat<T> x(b, n_, n_rhs, false, true);
+        x -= update_w_ * (update_m_ * x.rows(update_rows_));
+        return true;
+    }
+
+    template <typename T>
+    bool lu<T>::update(const arma::uvec& rows, const arma::Mat<T>& delta)
+    {
+        if (!factorized_ || delta.n_rows != rows.n_elem || delta.n_cols != rows.n_elem) {
+            return false;
+        }
+        auto new_rows = update_rows_;
+        auto new_delta = update_delta_;
+        auto new_w = update_w_;
+        arma::uvec offsets(rows.n_elem);
+        for (auto i = 0U; i < rows.n_elem; ++i) {
+            if (rows[i] >= n_) {
+                return false;
+            }
+            const arma::uvec found = arma::find(new_rows == rows[i], 1);
+            if (!found.is_empty()) {
+                offsets[i] = found[0];
+                continue;
+            }
+            if (new_rows.n_elem >= max_rank) {
+                return false;
+            }
+            // Each newly modified row extends E and W by a column.
+            offsets[i] = new_rows.n_elem;
+            new_rows.resize(offsets[i] + 1);
+            new_rows[offsets[i]] = rows[i];
+            new_delta.resize(offsets[i] + 1, offsets[i] + 1);
+            arma::Col<T> w(n_, arma::fill::zeros);
+            w[rows[i]] = 1;
+            if (!solve_factors(w.memptr(), 1)) {
+                return false;
+            }
+            new_w.insert_cols(offsets[i], w);
+        }
+        new_delta.submat(offsets, offsets) += delta;
+        // S = I + E^T * W * D is singular iff the modified matrix is.
+        const auto rank = new_rows.n_elem;
+        const arma::Mat<T> s = arma::eye<arma::Mat<T>>(rank, rank) + new_w.rows(new_rows) * new_delta;
+        arma::Mat<T> s_inv;
+        if (arma::rcond(s) < std::numeric_limits<double>::epsilon() || !arma::inv(s_inv, s)) {
+            return false;
+        }
+        update_rows_ = std::move(new_rows);
+        update_delta_ = std::move(new_delta);
+        update_w_ = std::move(new_w);
+        update_m_ = update_delta_ * s_inv;
+        return true;
+    }
+
+    template <typename T>
+    void lu<T>::revert()
+    {
+        update_rows_.reset();
+        update_delta_.reset();
+        update_w_.reset();
+        update_m_.reset();
+    }
+}
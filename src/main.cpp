@@ -5,9 +5,34 @@
 //
 
 #include "factory.hpp"
+#include "profiler.hpp"
+
+#include <cstdlib>
+#include <new>
 
 /// Bootstrap the program.
 int main(int argc, char** argv)
 {
     flow::factory::get()->get_executor()->execute(argc, argv);
 }
+
+// Allocations are counted by replacing global operator new. Array and nothrow forms
+// forward to this one.
+void* operator new(std::size_t size)
+{
+    flow::profiler::count_allocation(size);
+    if (const auto ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
@@ -0,0 +1,80 @@
+//
+// arma-flow/mapped_file.cpp
+//
+// @author CismonX
+//
+
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+namespace flow
+{
+    mapped_file::~mapped_file()
+    {
+        close();
+    }
+
+    bool mapped_file::open(const std::string& path)
+    {
+        close();
+#ifdef _WIN32
+        std::ifstream ifstream(path, std::ios::binary);
+        if (!ifstream) {
+            return false;
+        }
+        buffer_.assign(std::istreambuf_iterator<char>(ifstream), std::istreambuf_iterator<char>());
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+        return true;
+#else
+        const auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+            ::close(fd);
+            return false;
+        }
+        size_ = st.st_size;
+        // Empty file cannot be mapped.
+        if (!size_) {
+            ::close(fd);
+            data_ = "";
+            return true;
+        }
+        const auto addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        // Mapping is kept after the file descriptor is closed.
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            size_ = 0;
+            return false;
+        }
+        madvise(addr, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(addr);
+        return true;
+#endif // _WIN32
+    }
+
+    void mapped_file::close()
+    {
+#ifdef _WIN32
+        buffer_.clear();
+#else
+        if (size_) {
+            munmap(const_cast<char*>(data_), size_);
+        }
+#endif // _WIN32
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
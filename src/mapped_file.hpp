@@ -0,0 +1,72 @@
+//
+// arma-flow/mapped_file.hpp
+//
+// @author CismonX
+//
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace flow
+{
+    /// Read-only memory mapping of a file.
+    class mapped_file
+    {
+        /// Contents of file.
+        const char* data_ = nullptr;
+
+        /// Size of file.
+        std::size_t size_ = 0;
+
+#ifdef _WIN32
+        /// Contents of file (read into memory, as mapping is not supported).
+        std::string buffer_;
+#endif // _WIN32
+
+    public:
+        /**
+         * Default constructor.
+         */
+        explicit mapped_file() = default;
+
+        /**
+         * Destructor.
+         */
+        ~mapped_file();
+
+        mapped_file(const mapped_file&) = delete;
+
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        /**
+         * Map a file into memory. Previously mapped file is closed.
+         *
+         * @param path Path to file.
+         * @return Whether file is successfully mapped.
+         */
+        bool open(const std::string& path);
+
+        /**
+         * Unmap the file.
+         */
+        void close();
+
+        /**
+         * Get contents of file.
+         */
+        const char* data() const
+        {
+            return data_;
+        }
+
+        /**
+         * Get size of file.
+         */
+        std::size_t size() const
+        {
+            return size_;
+        }
+    };
+}
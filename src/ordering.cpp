@@ -0,0 +1,142 @@
+//
+// arma-flow/ordering.cpp
+//
+// @author CismonX
+//
+
+#include "ordering.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <set>
+
+namespace flow
+{
+    std::vector<unsigned> ordering::minimum_degree(graph& adj)
+    {
+        const auto n = static_cast<unsigned>(adj.size());
+        // Remaining nodes, ordered by degree, then by offset.
+        std::set<std::pair<std::size_t, unsigned>> queue;
+        for (auto node = 0U; node < n; ++node) {
+            queue.emplace(adj[node].size(), node);
+        }
+        std::vector<unsigned> retval, merged;
+        retval.reserve(n);
+        while (!queue.empty()) {
+            const auto node = queue.begin()->second;
+            queue.erase(queue.begin());
+            retval.push_back(node);
+            // Eliminating a node connects all its remaining neighbours with each other.
+            const auto& clique = adj[node];
+            for (auto&& neighbor : clique) {
+                auto& list = adj[neighbor];
+                queue.erase({ list.size(), neighbor });
+                merged.clear();
+                std::set_union(list.begin(), list.end(), clique.begin(), clique.end(), std::back_inserter(merged));
+                merged.erase(std::remove_if(merged.begin(), merged.end(), [node, neighbor](unsigned other)
+                {
+                    return other == node || other == neighbor;
+                }), merged.end());
+                list.swap(merged);
+                queue.emplace(list.size(), neighbor);
+            }
+            std::vector<unsigned>().swap(adj[node]);
+        }
+        return retval;
+    }
+
+    std::vector<unsigned> ordering::reverse_cuthill_mckee(const graph& adj)
+    {
+        const auto n = static_cast<unsigned>(adj.size());
+        std::vector<unsigned> retval, queue, neighbors;
+        retval.reserve(n);
+        std::vector<unsigned> mark(n), depth(n);
+        std::vector<bool> visited(n);
+        auto stamp = 0U;
+        // Breadth-first search in the component of root, where neighbours are visited
+        // by increasing degree. Nodes are left in queue in the order of visit.
+        const auto bfs = [&](unsigned root)
+        {
+            ++stamp;
+            queue.assign(1, root);
+            mark[root] = stamp;
+            depth[root] = 0;
+            for (auto i = 0U; i < queue.size(); ++i) {
+                const auto node = queue[i];
+                neighbors.clear();
+                for (auto&& neighbor : adj[node]) {
+                    if (mark[neighbor] != stamp) {
+                        mark[neighbor] = stamp;
+                        depth[neighbor] = depth[node] + 1;
+                        neighbors.push_back(neighbor);
+                    }
+                }
+                std::stable_sort(neighbors.begin(), neighbors.end(), [&adj](unsigned n1, unsigned n2)
+                {
+                    return adj[n1].size() < adj[n2].size();
+                });
+                queue.insert(queue.end(), neighbors.begin(), neighbors.end());
+            }
+        };
+        for (auto start = 0U; start < n; ++start) {
+            if (visited[start]) {
+                continue;
+            }
+            // Pseudo-peripheral node (by George and Liu): move to a node of minimum degree
+            // in the last level, until eccentricity no longer grows.
+            bfs(start);
+            auto eccentricity = depth[queue.back()];
+            while (eccentricity) {
+                auto candidate = queue.back();
+                for (auto iter = queue.rbegin(); iter != queue.rend() && depth[*iter] == eccentricity; ++iter) {
+                    if (adj[*iter].size() < adj[candidate].size()) {
+                        candidate = *iter;
+                    }
+                }
+                bfs(candidate);
+                if (depth[queue.back()] <= eccentricity) {
+                    break;
+                }
+                eccentricity = depth[queue.back()];
+            }
+            for (auto&& node : queue) {
+                visited[node] = true;
+            }
+            retval.insert(retval.end(), queue.begin(), queue.end());
+        }
+        std::reverse(retval.begin(), retval.end());
+        return retval;
+    }
+
+    std::vector<unsigned> ordering::compute(method_type method, unsigned n, const arma::uword* col_ptrs,
+        const arma::uword* row_indices)
+    {
+        if (method == colamd) {
+            return { };
+        }
+        // Row indices of each column are sorted, so are the adjacency lists.
+        graph adj(n);
+        for (auto col = 0U; col < n; ++col) {
+            auto& list = adj[col];
+            list.reserve(col_ptrs[col + 1] - col_ptrs[col]);
+            for (auto k = col_ptrs[col]; k < col_ptrs[col + 1]; ++k) {
+                if (row_indices[k] != col) {
+                    list.push_back(row_indices[k]);
+                }
+            }
+        }
+        return method == rcm ? reverse_cuthill_mckee(adj) : minimum_degree(adj);
+    }
+
+    const char* ordering::name(method_type method)
+    {
+        switch (method) {
+            case min_degree:
+                return "md";
+            case rcm:
+                return "rcm";
+            default:
+                return "colamd";
+        }
+    }
+}
@@ -0,0 +1,69 @@
+//
+// arma-flow/ordering.hpp
+//
+// @author CismonX
+//
+
+#pragma once
+
+#include <armadillo>
+#include <vector>
+
+namespace flow
+{
+    /// Fill-reducing ordering of nodes, computed on the graph of a structurally symmetric
+    /// matrix (such as node admittance matrix), where diagonal elements are ignored.
+    class ordering
+    {
+    public:
+        /// Method of ordering.
+        enum method_type {
+            /// No ordering of nodes. Each matrix is ordered by SuperLU (COLAMD) on its own.
+            colamd,
+            /// Minimum degree.
+            min_degree,
+            /// Reverse Cuthill-McKee.
+            rcm
+        };
+
+    private:
+        /// Adjacency lists of nodes (sorted, excluding the node itself).
+        using graph = std::vector<std::vector<unsigned>>;
+
+        /**
+         * Get minimum degree ordering. Elimination graph is updated explicitly, so that
+         * degrees are exact. Ties are broken by node offset.
+         *
+         * @param adj Adjacency lists, which will be consumed.
+         * @return Node offsets in elimination order.
+         */
+        static std::vector<unsigned> minimum_degree(graph& adj);
+
+        /**
+         * Get reverse Cuthill-McKee ordering. Each connected component starts from
+         * a pseudo-peripheral node.
+         *
+         * @param adj Adjacency lists.
+         * @return Node offsets in elimination order.
+         */
+        static std::vector<unsigned> reverse_cuthill_mckee(const graph& adj);
+
+    public:
+        /**
+         * Compute ordering of nodes.
+         *
+         * @param method Method of ordering.
+         * @param n Number of nodes.
+         * @param col_ptrs Column pointers of matrix.
+         * @param row_indices Row indices of matrix.
+         * @return Node offsets in elimination order (empty for colamd).
+         */
+        static std::vector<unsigned> compute(method_type method, unsigned n, const arma::uword* col_ptrs,
+            const arma::uword* row_indices);
+
+        /**
+         * Get name of ordering method.
+         */
+        static const char* name(method_type method);
+    };
+}
@@ -0,0 +1,145 @@
+//
+// arma-flow/output_buffer.cpp
+//
+// @author CismonX
+//
+
+#include "output_buffer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+
+namespace flow
+{
+    output_buffer::~output_buffer()
+    {
+        close();
+    }
+
+    bool output_buffer::open(const std::string& path, bool background)
+    {
+        close();
+        failed_ = false;
+        ofstream_.open(path, std::ios::binary);
+        if (!ofstream_) {
+            return false;
+        }
+        block_.reserve(block_size);
+        background_ = background;
+        if (background_) {
+            closing_ = false;
+            thread_ = std::thread(&output_buffer::run, this);
+        }
+        return true;
+    }
+
+    bool output_buffer::close()
+    {
+        if (!ofstream_.is_open()) {
+            return true;
+        }
+        if (!block_.empty()) {
+            flush_block();
+        }
+        if (background_) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                closing_ = true;
+            }
+            cond_.notify_all();
+            thread_.join();
+            background_ = false;
+        }
+        ofstream_.close();
+        if (ofstream_.fail()) {
+            failed_ = true;
+        }
+        return !failed_;
+    }
+
+    void output_buffer::run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cond_.wait(lock, [this] { return closing_ || !pending_.empty(); });
+            if (pending_.empty()) {
+                return;
+            }
+            auto block = std::move(pending_.front());
+            pending_.pop_front();
+            lock.unlock();
+            if (!ofstream_.write(block.data(), block.size())) {
+                failed_ = true;
+            }
+            block.clear();
+            lock.lock();
+            free_.push_back(std::move(block));
+            cond_.notify_all();
+        }
+    }
+
+    void output_buffer::flush_block()
+    {
+        if (!background_) {
+            if (!ofstream_.write(block_.data(), block_.size())) {
+                failed_ = true;
+            }
+            block_.clear();
+            return;
+        }
+        // At most two blocks are pending, so that memory usage is bounded when the
+        // file is written slower than it is formatted.
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return pending_.size() < 2; });
+        pending_.push_back(std::move(block_));
+        if (free_.empty()) {
+            block_ = std::vector<char>();
+            block_.reserve(block_size);
+        } else {
+            block_ = std::move(free_.back());
+            free_.pop_back();
+        }
+        lock.unlock();
+        cond_.notify_all();
+    }
+
+    char* output_buffer::format_double(char* first, double val)
+    {
+        // Negative zero is printed as zero.
+        if (val == 0) {
+            val = 0;
+        }
+#ifdef __cpp_lib_to_chars
+        auto last = std::to_chars(first, first + max_double_length, val, std::chars_format::fixed, 6).ptr;
+#else
+        auto last = first + std::snprintf(first, max_double_length, "%.6f", val);
+#endif // __cpp_lib_to_chars
+        if (!std::isfinite(val)) {
+            return last;
+        }
+        // Trailing zeros (and the decimal point, if no decimal places remain) are removed.
+        while (last[-1] == '0') {
+            --last;
+        }
+        if (last[-1] == '.') {
+            --last;
+        }
+        return last;
+    }
+
+    char* output_buffer::format_uint(char* first, unsigned long long val)
+    {
+        // Digits are generated in reverse order.
+        auto last = first;
+        do {
+            *last++ = static_cast<char>('0' + val % 10);
+            val /= 10;
+        } while (val);
+        std::reverse(first, last);
+        return last;
+    }
+}
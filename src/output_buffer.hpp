@@ -0,0 +1,150 @@
+//
+// arma-flow/output_buffer.hpp
+//
+// @author CismonX
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace flow
+{
+    /// Buffered output to a file, which is flushed in large blocks, optionally by a background thread.
+    class output_buffer
+    {
+        /// Size of each block.
+        static constexpr std::size_t block_size = 1 << 20;
+
+        /// The output file.
+        std::ofstream ofstream_;
+
+        /// Block being filled.
+        std::vector<char> block_;
+
+        /// Whether blocks are written by a background thread.
+        bool background_ = false;
+
+        /// The background thread.
+        std::thread thread_;
+
+        /// Protects the queues below.
+        std::mutex mutex_;
+
+        /// Notifies the background thread of new blocks, and the foreground thread of free blocks.
+        std::condition_variable cond_;
+
+        /// Blocks to be written.
+        std::deque<std::vector<char>> pending_;
+
+        /// Blocks already written, to be reused.
+        std::vector<std::vector<char>> free_;
+
+        /// Whether no more blocks will be queued.
+        bool closing_ = false;
+
+        /// Whether any write failed.
+        std::atomic<bool> failed_ { false };
+
+        /**
+         * Write blocks in the queue, until closed.
+         */
+        void run();
+
+        /**
+         * Write current block to file, or queue it for the background thread.
+         */
+        void flush_block();
+
+    public:
+        /// Size of buffer required to format a double.
+        static constexpr std::size_t max_double_length = 330;
+
+        /**
+         * Default constructor.
+         */
+        explicit output_buffer() = default;
+
+        /**
+         * Destructor. Remaining data is flushed.
+         */
+        ~output_buffer();
+
+        output_buffer(const output_buffer&) = delete;
+
+        output_buffer& operator=(const output_buffer&) = delete;
+
+        /**
+         * Open a file for output. Previously opened file is closed.
+         *
+         * @param path Path to file.
+         * @param background Whether blocks are written by a background thread.
+         * @return Whether file is successfully opened.
+         */
+        bool open(const std::string& path, bool background);
+
+        /**
+         * Flush remaining data and close the file.
+         *
+         * @return Whether all data is successfully written.
+         */
+        bool close();
+
+        /**
+         * Check whether a file is opened.
+         */
+        bool is_open() const
+        {
+            return ofstream_.is_open();
+        }
+
+        /**
+         * Append data to buffer.
+         *
+         * @param data Data to be appended.
+         * @param size Size of data.
+         */
+        void write(const char* data, std::size_t size)
+        {
+            if (block_.size() + size > block_size && !block_.empty()) {
+                flush_block();
+            }
+            block_.insert(block_.end(), data, data + size);
+        }
+
+        /**
+         * Append a string to buffer.
+         *
+         * @param str String to be appended.
+         */
+        void write(const std::string& str)
+        {
+            write(str.data(), str.size());
+        }
+
+        /**
+         * Format a double in fixed notation with at most 6 decimal places, trailing zeros removed.
+         *
+         * @param first Beginning of output, which should have at least max_double_length bytes.
+         * @param val Value to be formatted.
+         * @return End of output.
+         */
+        static char* format_double(char* first, double val);
+
+        /**
+         * Format an unsigned integer.
+         *
+         * @param first Beginning of output, which should have at least 20 bytes.
+         * @param val Value to be formatted.
+         * @return End of output.
+         */
+        static char* format_uint(char* first, unsigned long long val);
+    };
+}
@@ -0,0 +1,113 @@
+//
+// arma-flow/parallel.hpp
+//
+// @author CismonX
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace flow
+{
+    /// Provides utilities for parallel execution.
+    class parallel
+    {
+    public:
+        /**
+         * Get number of threads to be used.
+         *
+         * @param requested Requested number of threads (0 for number of hardware threads).
+         * @return Number of threads.
+         */
+        static unsigned threads(unsigned requested)
+        {
+            if (requested) {
+                return requested;
+            }
+            const auto hardware = std::thread::hardware_concurrency();
+            return hardware ? hardware : 1;
+        }
+
+        /**
+         * Split [0, count) into contiguous ranges of similar total weight.
+         *
+         * @param prefix Prefix sums of weights (count + 1 elements, starting at 0).
+         * @param count Number of items.
+         * @param parts Max number of ranges.
+         * @return Bounds of non-empty ranges, from 0 to count.
+         */
+        template <typename T>
+        static std::vector<unsigned> partition(const T* prefix, unsigned count, unsigned parts)
+        {
+            std::vector<unsigned> bounds { 0 };
+            for (auto part = 1U; part < parts; ++part) {
+                const auto target = prefix[0] + (prefix[count] - prefix[0]) * part / parts;
+                const auto bound = static_cast<unsigned>(std::lower_bound(prefix, prefix + count, target) - prefix);
+                if (bound > bounds.back()) {
+                    bounds.push_back(bound);
+                }
+            }
+            if (count > bounds.back()) {
+                bounds.push_back(count);
+            }
+            return bounds;
+        }
+
+        /**
+         * Run a task for each index in [0, count) with a pool of threads. Indices are
+         * dispatched dynamically, so that tasks of uneven cost are balanced. If any
+         * task throws, the first exception is rethrown after all threads finish.
+         *
+         * @param count Number of tasks.
+         * @param threads Number of threads.
+         * @param func Callback for each task, with the index of task and thread.
+         */
+        template <typename F>
+        static void for_each(unsigned count, unsigned threads, F func)
+        {
+            threads = std::min(parallel::threads(threads), count);
+            if (threads <= 1) {
+                for (auto i = 0U; i < count; ++i) {
+                    func(i, 0U);
+                }
+                return;
+            }
+            std::atomic<unsigned> next(0);
+            std::exception_ptr exception;
+            std::mutex mutex;
+            const auto worker = [&](unsigned thread)
+            {
+                try {
+                    for (auto i = next++; i < count; i = next++) {
+                        func(i, thread);
+                    }
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!exception) {
+                        exception = std::current_exception();
+                    }
+                    // Skip remaining tasks.
+                    next = count;
+                }
+            };
+            std::vector<std::thread> pool;
+            pool.reserve(threads - 1);
+            for (auto thread = 1U; thread < threads; ++thread) {
+                pool.emplace_back(worker, thread);
+            }
+            worker(0);
+            for (auto&& thread : pool) {
+                thread.join();
+            }
+            if (exception) {
+                std::rethrow_exception(exception);
+            }
+        }
+    };
+}
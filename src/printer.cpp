@@ -0,0 +1,87 @@
+//
+// arma-flow/printer.cpp
+//
+// @author CismonX
+//
+
+#include "printer.hpp"
+#include "output_buffer.hpp"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif // _WIN32
+
+namespace flow
+{
+    int printer::max_elems_per_line()
+    {
+#ifdef _WIN32
+        CONSOLE_SCREEN_BUFFER_INFO csbi;
+        if (!GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi)) {
+            return 10;
+        }
+        const auto width = csbi.dwSize.X;
+#else
+        winsize win;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &win) == -1) {
+            return 10;
+        }
+        const auto width = win.ws_col;
+#endif // _WIN32
+        return std::floor((width - 7) / 11);
+    }
+
+    void printer::print_row(const arma::rowvec& row, int elems, std::string& line)
+    {
+        line.clear();
+        auto counter = 0;
+        for (auto&& elem : row) {
+            if (++counter > elems) {
+                line += "...(" + std::to_string(row.n_elem - elems) + ')';
+                break;
+            }
+            // Left aligned, with width of 10.
+            const auto begin = line.size();
+            char buffer[output_buffer::max_double_length];
+            line.append(buffer, output_buffer::format_double(buffer, elem));
+            if (line.size() - begin < 10) {
+                line.append(10 - (line.size() - begin), ' ');
+            }
+            line += ' ';
+        }
+        line += '\n';
+        std::cout.write(line.data(), line.size());
+    }
+
+    void printer::print_mat(const arma::mat& mat)
+    {
+        // Width of stdout is checked only once for each matrix.
+        const auto elems = max_elems_per_line();
+        std::string line;
+        mat.each_row([elems, &line](const arma::rowvec& row)
+        {
+            print_row(row, elems, line);
+        });
+        std::cout.flush();
+    }
+
+    void printer::print_mat(const arma::sp_mat& mat)
+    {
+        const auto elems = max_elems_per_line();
+        std::string line;
+        sp_mat_each_row(mat, [elems, &line](const arma::rowvec& row)
+        {
+            print_row(row, elems, line);
+        });
+        std::cout.flush();
+    }
+
+    void printer::print_complex(const std::string& prefix, const std::complex<double>& complex)
+    {
+        std::cout << prefix << complex.real() << (complex.imag() < 0 ? '-' : '+') <<
+            'j' << std::abs(complex.imag()) << std::endl;
+    }
+}
@@ -0,0 +1,99 @@
+//
+// arma-flow/printer.hpp
+//
+// @author CismonX
+//
+
+#pragma once
+
+#include <armadillo>
+#include <complex>
+#include <iostream>
+#include <string>
+
+namespace flow
+{
+    /// Prints messages and matrices to stdout. Never terminates the program, so that it can be
+    /// used by the calculation path (see writer for file output and errors).
+    class printer
+    {
+        /**
+         * Determines width of stdout.
+         *
+         * @return Character width.
+         */
+        static int max_elems_per_line();
+
+        /**
+         * Traverse rows of a sparse matrix as dense row vectors.
+         *
+         * @param mat Matrix to be traversed.
+         * @param func Callback for each row.
+         */
+        template <typename F>
+        static void sp_mat_each_row(const arma::sp_mat& mat, F func)
+        {
+            // Columns of the transposed matrix are rows of the original one.
+            const arma::sp_mat trans = mat.t();
+            arma::rowvec row(mat.n_cols);
+            for (auto col = 0U; col < trans.n_cols; ++col) {
+                row.zeros();
+                for (auto i = trans.col_ptrs[col]; i < trans.col_ptrs[col + 1]; ++i) {
+                    row[trans.row_indices[i]] = trans.values[i];
+                }
+                func(row);
+            }
+        }
+
+        /**
+         * Print a row vector to stdout.
+         *
+         * @param row Row vector to be printed.
+         * @param elems Max number of elements per line.
+         * @param line Buffer of line, reused across rows.
+         */
+        static void print_row(const arma::rowvec& row, int elems, std::string& line);
+
+    public:
+        /**
+         * Print a line to stdout.
+         *
+         * @param message Messages to be printed.
+         */
+        template <typename ...T>
+        static void println(T&&... message)
+        {
+            (std::cout << ... << message) << std::endl;
+        }
+
+        /**
+         * Print a notice message to stdout.
+         *
+         * @param message Messages to be printed.
+         */
+        template <typename ...T>
+        static void notice(T&&... message)
+        {
+            (std::cout << "Notice: " << ... << message) << std::endl;
+        }
+
+        /**
+         * Print a matrix to stdout.
+         *
+         * @param mat Matrix to be printed.
+         */
+        static void print_mat(const arma::mat& mat);
+
+        /**
+         * Print a sparse matrix to stdout.
+         *
+         * @param mat Matrix to be printed.
+         */
+        static void print_mat(const arma::sp_mat& mat);
+
+        /**
+         * Print a complex number to stdout.
+         */
+        static void print_complex(const std::string& prefix, const std::complex<double>& complex);
+    };
+}
@@ -0,0 +1,149 @@
+//
+// arma-flow/profiler.cpp
+//
+// @author CismonX
+//
+
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif // _WIN32
+
+namespace flow
+{
+    namespace
+    {
+        /// Number of allocations.
+        std::atomic<unsigned long long> num_allocations(0);
+
+        /// Total size of allocations.
+        std::atomic<unsigned long long> allocated_bytes(0);
+
+        /**
+         * Get peak resident set size of this process.
+         *
+         * @return Peak resident set size in kilobytes (0 if not available).
+         */
+        long peak_rss()
+        {
+#ifdef _WIN32
+            return 0;
+#else
+            rusage usage;
+            if (getrusage(RUSAGE_SELF, &usage) == -1) {
+                return 0;
+            }
+#ifdef __APPLE__
+            // In bytes rather than kilobytes.
+            return usage.ru_maxrss / 1024;
+#else
+            return usage.ru_maxrss;
+#endif // __APPLE__
+#endif // _WIN32
+        }
+
+        /**
+         * Escape a string for JSON.
+         *
+         * @param str String to be escaped.
+         * @return Quoted string.
+         */
+        std::string quote(const std::string& str)
+        {
+            std::string retval = "\"";
+            for (auto c : str) {
+                if (c == '"' || c == '\\') {
+                    retval += '\\';
+                }
+                retval += c;
+            }
+            return retval + '"';
+        }
+    }
+
+    bool profiler::enabled_ = false;
+
+    profiler::clock::time_point profiler::start_;
+
+    std::mutex profiler::mutex_;
+
+    std::vector<profiler::stage> profiler::stages_;
+
+    std::vector<std::pair<std::string, std::string>> profiler::info_;
+
+    void profiler::enable()
+    {
+        enabled_ = true;
+        start_ = clock::now();
+    }
+
+    void profiler::record(const char* name, double seconds)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Only a few stages exist, linear search is fast enough.
+        for (auto&& stage : stages_) {
+            if (stage.name == name) {
+                ++stage.count;
+                stage.total += seconds;
+                stage.min = std::min(stage.min, seconds);
+                stage.max = std::max(stage.max, seconds);
+                return;
+            }
+        }
+        stages_.push_back({ name, 1, seconds, seconds, seconds });
+    }
+
+    void profiler::add_info(const std::string& key, const std::string& json)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        info_.emplace_back(key, json);
+    }
+
+    void profiler::info(const std::string& key, double val)
+    {
+        std::ostringstream stream;
+        stream << val;
+        add_info(key, stream.str());
+    }
+
+    void profiler::info(const std::string& key, const std::string& val)
+    {
+        add_info(key, quote(val));
+    }
+
+    void profiler::count_allocation(std::size_t size)
+    {
+        num_allocations.fetch_add(1, std::memory_order_relaxed);
+        allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    std::string profiler::to_json()
+    {
+        const auto total = std::chrono::duration<double>(clock::now() - start_).count();
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::ostringstream stream;
+        stream.precision(9);
+        stream << "{\n";
+        for (auto&& info : info_) {
+            stream << "  " << quote(info.first) << ": " << info.second << ",\n";
+        }
+        stream << "  \"stages\": [";
+        for (auto i = 0U; i < stages_.size(); ++i) {
+            const auto& stage = stages_[i];
+            stream << (i ? ",\n" : "\n") << "    { \"name\": " << quote(stage.name) << ", \"count\": " <<
+                stage.count << ", \"total\": " << stage.total << ", \"min\": " << stage.min <<
+                ", \"max\": " << stage.max << " }";
+        }
+        stream << "\n  ],\n";
+        stream << "  \"total\": " << total << ",\n";
+        stream << "  \"peak_rss_kb\": " << peak_rss() << ",\n";
+        stream << "  \"allocations\": " << num_allocations.load() << ",\n";
+        stream << "  \"allocated_bytes\": " << allocated_bytes.load() << "\n";
+        stream << "}\n";
+        return stream.str();
+    }
+}
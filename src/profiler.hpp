@@ -0,0 +1,149 @@
+//
+// arma-flow/profiler.hpp
+//
+// @author CismonX
+//
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace flow
+{
+    /// Collects timing of each stage of calculation, as well as memory usage.
+    class profiler
+    {
+        /// Clock used for timing.
+        using clock = std::chrono::steady_clock;
+
+        /// Timing of a stage.
+        struct stage
+        {
+            /// Name of stage.
+            std::string name;
+
+            /// Number of times the stage is run.
+            unsigned long long count;
+
+            /// Total, min and max time (in seconds).
+            double total, min, max;
+        };
+
+        /// Whether profiling is enabled.
+        static bool enabled_;
+
+        /// Time when profiling is enabled.
+        static clock::time_point start_;
+
+        /// Protects stages and info.
+        static std::mutex mutex_;
+
+        /// Timing of stages, in the order of first run.
+        static std::vector<stage> stages_;
+
+        /// Information of the run, as JSON key and value pairs.
+        static std::vector<std::pair<std::string, std::string>> info_;
+
+        /**
+         * Record timing of a stage.
+         *
+         * @param name Name of stage.
+         * @param seconds Time spent.
+         */
+        static void record(const char* name, double seconds);
+
+        /**
+         * Add information of the run.
+         *
+         * @param key Key.
+         * @param json Value, in JSON format.
+         */
+        static void add_info(const std::string& key, const std::string& json);
+
+    public:
+        /// Measures time spent in a scope, if profiling is enabled.
+        class scope
+        {
+            /// Name of stage.
+            const char* name_;
+
+            /// Time when scope is entered.
+            clock::time_point begin_;
+
+        public:
+            /**
+             * Constructor.
+             *
+             * @param name Name of stage (should be a string literal).
+             */
+            explicit scope(const char* name) : name_(enabled_ ? name : nullptr)
+            {
+                if (name_) {
+                    begin_ = clock::now();
+                }
+            }
+
+            /**
+             * Destructor.
+             */
+            ~scope()
+            {
+                if (name_) {
+                    record(name_, std::chrono::duration<double>(clock::now() - begin_).count());
+                }
+            }
+
+            scope(const scope&) = delete;
+
+            scope& operator=(const scope&) = delete;
+        };
+
+        /**
+         * Enable profiling.
+         */
+        static void enable();
+
+        /**
+         * Check whether profiling is enabled.
+         */
+        static bool enabled()
+        {
+            return enabled_;
+        }
+
+        /**
+         * Add numeric information of the run.
+         *
+         * @param key Key.
+         * @param val Value.
+         */
+        static void info(const std::string& key, double val);
+
+        /**
+         * Add string information of the run.
+         *
+         * @param key Key.
+         * @param val Value.
+         */
+        static void info(const std::string& key, const std::string& val);
+
+        /**
+         * Count a heap allocation. Called by global operator new, which is replaced by the
+         * program (but not the library, so as not to interfere with the host program).
+         *
+         * @param size Size of allocation.
+         */
+        static void count_allocation(std::size_t size);
+
+        /**
+         * Generate report in JSON format. Time of stages run concurrently is summed up.
+         *
+         * @return Report, including timing of each stage, total time, peak resident set
+         *         size, and number and size of allocations (through operator new).
+         */
+        static std::string to_json();
+    };
+}
@@ -5,36 +5,279 @@
 //
 
 #include "reader.hpp"
+#include "parallel.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <experimental/filesystem>
+#include <numeric>
+#include <utility>
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
 
 namespace flow
 {
+    namespace
+    {
+        /// Files larger than this are parsed in parallel.
+        constexpr std::size_t parallel_threshold = 1 << 20;
+
+        /**
+         * Traverse non-blank lines of text.
+         *
+         * @param begin Beginning of text.
+         * @param end End of text.
+         * @param func Callback for each line, with its beginning and end (excluding line break).
+         */
+        template <typename F>
+        void line_foreach(const char* begin, const char* end, F func)
+        {
+            while (begin != end) {
+                auto line_end = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+                if (!line_end) {
+                    line_end = end;
+                }
+                if (std::any_of(begin, line_end, [](char c) { return !std::isspace(static_cast<unsigned char>(c)); })) {
+                    if (!func(begin, line_end)) {
+                        return;
+                    }
+                }
+                begin = line_end == end ? end : line_end + 1;
+            }
+        }
+
+        /**
+         * Parse a field of CSV text as double. Empty field is parsed as zero.
+         *
+         * @param begin Beginning of field.
+         * @param end End of field.
+         * @param val Parsed value.
+         * @return Whether parse is successful.
+         */
+        bool parse_double(const char* begin, const char* end, double& val)
+        {
+            while (begin != end && std::isspace(static_cast<unsigned char>(*begin))) {
+                ++begin;
+            }
+            while (end != begin && std::isspace(static_cast<unsigned char>(end[-1]))) {
+                --end;
+            }
+            if (begin == end) {
+                val = 0;
+                return true;
+            }
+            if (*begin == '+') {
+                ++begin;
+            }
+#ifdef __cpp_lib_to_chars
+            const auto result = std::from_chars(begin, end, val);
+            return result.ec == std::errc() && result.ptr == end;
+#else
+            // Floating point std::from_chars is not available, fields are short enough to be copied.
+            char buffer[64];
+            const auto length = static_cast<std::size_t>(end - begin);
+            if (length >= sizeof buffer) {
+                return false;
+            }
+            std::memcpy(buffer, begin, length);
+            buffer[length] = '\0';
+            char* parsed;
+            val = std::strtod(buffer, &parsed);
+            return parsed == buffer + length;
+#endif // __cpp_lib_to_chars
+        }
+    }
+
+    bool reader::do_read(const char* begin, const char* end)
+    {
+        mat_.clear();
+        // Split text into chunks at line boundaries.
+        const auto size = static_cast<std::size_t>(end - begin);
+        const auto n_chunks = size < parallel_threshold ? 1U : parallel::threads(threads_);
+        std::vector<const char*> bounds { begin };
+        for (auto i = 1U; i < n_chunks; ++i) {
+            auto bound = std::max(begin + size / n_chunks * i, bounds.back());
+            bound = std::find(bound, end, '\n');
+            bounds.push_back(bound == end ? end : bound + 1);
+        }
+        bounds.push_back(end);
+        // First pass: count rows and columns of each chunk, so that each chunk knows
+        // where its rows start.
+        std::vector<arma::uword> n_rows(n_chunks + 1), n_cols(n_chunks);
+        parallel::for_each(n_chunks, n_chunks, [&](unsigned chunk, unsigned)
+        {
+            line_foreach(bounds[chunk], bounds[chunk + 1], [&](const char* line, const char* line_end)
+            {
+                ++n_rows[chunk + 1];
+                n_cols[chunk] = std::max<arma::uword>(n_cols[chunk], std::count(line, line_end, ',') + 1);
+                return true;
+            });
+        });
+        std::partial_sum(n_rows.begin(), n_rows.end(), n_rows.begin());
+        // Second pass: parse fields directly into the matrix. Missing fields are zero.
+        mat_.zeros(n_rows.back(), *std::max_element(n_cols.begin(), n_cols.end()));
+        std::vector<char> success(n_chunks, true);
+        parallel::for_each(n_chunks, n_chunks, [&](unsigned chunk, unsigned)
+        {
+            auto row = n_rows[chunk];
+            line_foreach(bounds[chunk], bounds[chunk + 1], [&](const char* line, const char* line_end)
+            {
+                for (auto col = 0U; line <= line_end; ++col) {
+                    auto field_end = std::find(line, line_end, ',');
+                    if (!parse_double(line, field_end, mat_.at(row, col))) {
+                        success[chunk] = false;
+                        return false;
+                    }
+                    line = field_end + 1;
+                }
+                ++row;
+                return true;
+            });
+        });
+        return std::all_of(success.begin(), success.end(), [](char ok) { return ok; });
+    }
+
     bool reader::from_csv_file(const std::string& path, bool remove_first_line)
     {
-        std::ifstream ifstream;
-        ifstream.exceptions(std::ifstream::failbit);
         namespace fs = std::experimental::filesystem;
-        try {
-            ifstream.open(
+        if (!file_.open(
 #ifdef _WIN32
-                path[1] == ':'
+            path[1] == ':'
 #else
-                path[0] == '/'
+            path[0] == '/'
 #endif // _WIN32
-                ? path : fs::current_path().string() + '/' + path);
-            if (remove_first_line) {
-                ifstream.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            ? path : fs::current_path().string() + '/' + path)) {
+            return false;
+        }
+        auto begin = file_.data();
+        const auto end = begin + file_.size();
+        if (remove_first_line) {
+            begin = std::find(begin, end, '\n');
+            begin = begin == end ? end : begin + 1;
+        }
+        const auto retval = do_read(begin, end);
+        file_.close();
+        return retval;
+    }
+
+    bool reader::from_case_file(const std::string& path)
+    {
+        namespace fs = std::experimental::filesystem;
+        case_header_ = nullptr;
+        case_nodes_.reset();
+        case_edges_.reset();
+        if (!case_file_.open(
+#ifdef _WIN32
+            path[1] == ':'
+#else
+            path[0] == '/'
+#endif // _WIN32
+            ? path : fs::current_path().string() + '/' + path)) {
+            return false;
+        }
+        const auto header = reinterpret_cast<const case_header*>(case_file_.data());
+        std::uint64_t file_size;
+        if (case_file_.size() < sizeof(case_header) || !header->valid() || !header->file_size(file_size) ||
+            case_file_.size() != file_size) {
+            case_file_.close();
+            return false;
+        }
+        case_header_ = header;
+        if ((header->flags & case_header::has_node_admittance) && !valid_case_node_admittance()) {
+            case_header_ = nullptr;
+            case_file_.close();
+            return false;
+        }
+        // Tables are used in place. They are never written to, though armadillo requires
+        // non-const memory.
+        const auto nodes = reinterpret_cast<double*>(const_cast<char*>(case_file_.data()) + sizeof(case_header));
+        const auto edges = nodes + header->node_rows * header->node_cols;
+        case_nodes_ = std::make_unique<const arma::mat>(nodes, header->node_rows, header->node_cols, false, true);
+        case_edges_ = std::make_unique<const arma::mat>(edges, header->edge_rows, header->edge_cols, false, true);
+        return true;
+    }
+
+    bool reader::case_node_admittance(arma::uvec& order, arma::sp_cx_mat& n_adm) const
+    {
+        if (!case_header_ || !(case_header_->flags & case_header::has_node_admittance)) {
+            return false;
+        }
+        const auto n = case_header_->node_rows;
+        const auto nnz = case_header_->y_nnz;
+        const auto section = case_node_admittance_section();
+        order = arma::uvec(std::vector<arma::uword>(section, section + n));
+        const arma::uvec col_ptrs(std::vector<arma::uword>(section + n, section + 2 * n + 1));
+        const arma::uvec row_indices(std::vector<arma::uword>(section + 2 * n + 1, section + 2 * n + 1 + nnz));
+        const auto values = reinterpret_cast<const std::complex<double>*>(section + 2 * n + 1 + nnz);
+        // Zeros are kept, so that the sparsity pattern only depends on network topology.
+        n_adm = arma::sp_cx_mat(row_indices, col_ptrs, arma::cx_colvec(values, nnz), n, n, false);
+        return true;
+    }
+
+    const std::uint64_t* reader::case_node_admittance_section() const
+    {
+        return reinterpret_cast<const std::uint64_t*>(case_file_.data() + sizeof(case_header)) +
+            case_header_->node_rows * case_header_->node_cols + case_header_->edge_rows * case_header_->edge_cols;
+    }
+
+    bool reader::valid_case_node_admittance() const
+    {
+        const auto n = case_header_->node_rows;
+        const auto nnz = case_header_->y_nnz;
+        const auto order = case_node_admittance_section();
+        const auto col_ptrs = order + n;
+        const auto row_indices = col_ptrs + n + 1;
+        for (auto i = 0U; i < n; ++i) {
+            if (order[i] >= n) {
+                return false;
+            }
+        }
+        if (col_ptrs[0] != 0 || col_ptrs[n] != nnz) {
+            return false;
+        }
+        for (auto col = 0U; col < n; ++col) {
+            if (col_ptrs[col] > col_ptrs[col + 1]) {
+                return false;
+            }
+            for (auto k = col_ptrs[col]; k < col_ptrs[col + 1]; ++k) {
+                if (row_indices[k] >= n || (k > col_ptrs[col] && row_indices[k] <= row_indices[k - 1])) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool reader::list_directory(const std::string& path, std::vector<std::string>& files)
+    {
+        namespace fs = std::experimental::filesystem;
+        files.clear();
+        try {
+            if (!fs::is_directory(path)) {
+                return false;
+            }
+            for (auto&& entry : fs::directory_iterator(path)) {
+                if (fs::is_regular_file(entry.status())) {
+                    files.push_back(entry.path().string());
+                }
             }
-            return do_read(ifstream);
         }
         catch (const std::exception&) {
             return false;
         }
+        std::sort(files.begin(), files.end());
+        return true;
     }
 
     const arma::mat& reader::get_mat() const
     {
         return mat_;
     }
+
+    arma::mat reader::take_mat()
+    {
+        return std::move(mat_);
+    }
 }
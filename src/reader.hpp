@@ -6,7 +6,12 @@
 
 #pragma once
 
+#include "case_format.hpp"
+#include "mapped_file.hpp"
+
 #include <armadillo>
+#include <memory>
+#include <vector>
 
 namespace flow
 {
@@ -16,31 +21,126 @@ namespace flow
         /// The loaded matrix.
         arma::mat mat_;
 
+        /// Number of threads for parsing large files (0 for number of hardware threads).
+        unsigned threads_ = 0;
+
+        /// The mapped input file.
+        mapped_file file_;
+
+        /// The mapped binary case file, kept mapped as long as it is used.
+        mapped_file case_file_;
+
+        /// Header of binary case file.
+        const case_header* case_header_ = nullptr;
+
+        /// Node table and edge table of binary case file (using memory of the mapped file).
+        std::unique_ptr<const arma::mat> case_nodes_, case_edges_;
+
         /**
-         * Read matrix from an istream.
-         * 
-         * @param istream The istream to be read.
-         * @return Whether read is successful.
+         * Parse CSV text into the loaded matrix. Large text is split into chunks at
+         * line boundaries, which are parsed in parallel.
+         *
+         * @param begin Beginning of text.
+         * @param end End of text.
+         * @return Whether parse is successful.
          */
-        bool do_read(std::istream& istream)
-        {
-            mat_.clear();
-            return mat_.load(istream, arma::csv_ascii);
-        }
+        bool do_read(const char* begin, const char* end);
+
+        /**
+         * Get the node admittance section of binary case file, which begins with node order,
+         * followed by column pointers and row indices.
+         */
+        const std::uint64_t* case_node_admittance_section() const;
+
+        /**
+         * Check node admittance matrix of binary case file, so that a corrupted file is
+         * rejected, rather than read out of bounds.
+         *
+         * @return Whether node order is in range, column pointers are non-decreasing and
+         *         end at the number of non-zero elements, and row indices of each column
+         *         are in range and strictly increasing.
+         */
+        bool valid_case_node_admittance() const;
 
     public:
         /**
-         * Read matrix from a CSV file. The first line will be ignored.
+         * Read matrix from a CSV file. The file is mapped into memory and parsed in place.
          * 
          * @param path Path to file.
          * @param remove_first_line Whether to remove the first line of CSV file.
          * @return Whether the file is successfully read.
          */
         bool from_csv_file(const std::string& path, bool remove_first_line);
-        
+
+        /**
+         * Read a binary case file. The file is mapped into memory, and the tables are used
+         * in place without parsing.
+         *
+         * @param path Path to file.
+         * @return Whether the file is successfully read.
+         */
+        bool from_case_file(const std::string& path);
+
+        /**
+         * Get node table of binary case file.
+         */
+        const arma::mat& case_nodes() const
+        {
+            return *case_nodes_;
+        }
+
+        /**
+         * Get edge table of binary case file.
+         */
+        const arma::mat& case_edges() const
+        {
+            return *case_edges_;
+        }
+
+        /**
+         * Check whether first column of node table of binary case file is node ID.
+         */
+        bool case_node_id() const
+        {
+            return case_header_->flags & case_header::has_node_id;
+        }
+
+        /**
+         * Get precomputed node admittance matrix of binary case file.
+         *
+         * @param order Original node offset of each sorted node.
+         * @param n_adm Node admittance matrix, in sorted node order.
+         * @return Whether node admittance matrix is included.
+         */
+        bool case_node_admittance(arma::uvec& order, arma::sp_cx_mat& n_adm) const;
+
+        /**
+         * List regular files in a directory, sorted by file name.
+         *
+         * @param path Path to directory.
+         * @param files Paths to files.
+         * @return Whether path is a readable directory.
+         */
+        static bool list_directory(const std::string& path, std::vector<std::string>& files);
+
+        /**
+         * Set number of threads for parsing large files.
+         *
+         * @param threads Number of threads (0 for number of hardware threads).
+         */
+        void set_threads(unsigned threads)
+        {
+            threads_ = threads;
+        }
+
         /**
          * Get loaded matrix.
          */
         const arma::mat& get_mat() const;
+
+        /**
+         * Move out loaded matrix, so that it is not copied.
+         */
+        arma::mat take_mat();
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,276 @@
+//
+// arma-flow/server.cpp
+//
+// @author CismonX
+//
+
+#include "server.hpp"
+#include "calc_error.hpp"
+#include "writer.hpp"
+
+#include <cstring>
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif // _WIN32
+
+namespace flow
+{
+#ifndef _WIN32
+    namespace
+    {
+        /// Set by signal handler, to stop serving.
+        volatile std::sig_atomic_t stop_ = 0;
+
+        void on_signal(int)
+        {
+            stop_ = 1;
+        }
+
+        /**
+         * Read exactly the given number of bytes.
+         *
+         * @return Whether data is read before EOF, error, or stop signal.
+         */
+        bool read_all(int fd, void* data, std::size_t size)
+        {
+            auto ptr = static_cast<char*>(data);
+            while (size) {
+                const auto n = ::read(fd, ptr, size);
+                if (n < 0 && errno == EINTR && !stop_) {
+                    continue;
+                }
+                if (n <= 0) {
+                    return false;
+                }
+                ptr += n;
+                size -= n;
+            }
+            return true;
+        }
+
+        /**
+         * Write exactly the given number of bytes.
+         *
+         * @return Whether data is written before error.
+         */
+        bool write_all(int fd, const void* data, std::size_t size)
+        {
+            auto ptr = static_cast<const char*>(data);
+            while (size) {
+                const auto n = ::write(fd, ptr, size);
+                if (n < 0 && errno == EINTR && !stop_) {
+                    continue;
+                }
+                if (n <= 0) {
+                    return false;
+                }
+                ptr += n;
+                size -= n;
+            }
+            return true;
+        }
+    }
+#endif // _WIN32
+
+    server::server(calc& base, unsigned max, double epsilon, bool short_circuit)
+        : base_(base), worker_(base), max_(max), epsilon_(epsilon), short_circuit_(short_circuit),
+          islanding_(base.bridges()) {}
+
+    void server::append(const void* data, std::size_t size)
+    {
+        const auto ptr = static_cast<const char*>(data);
+        response_.insert(response_.end(), ptr, ptr + size);
+    }
+
+    void server::append_result(unsigned n_iter)
+    {
+        const std::uint32_t head[] = { n_iter, 0 };
+        append(head, sizeof head);
+        // Transposed, so that values of each node are contiguous.
+        const arma::mat result = worker_.result().t();
+        append(result.memptr(), result.n_elem * sizeof(double));
+    }
+
+    bool server::converge(unsigned& n_iter)
+    {
+        do {
+            n_iter = worker_.solve();
+            if (worker_.get_max() <= epsilon_) {
+                return true;
+            }
+        } while (n_iter < max_);
+        return false;
+    }
+
+    std::uint32_t server::handle(std::uint32_t type, const std::vector<char>& payload)
+    {
+        response_.clear();
+        try {
+            switch (type) {
+                case base: {
+                    if (!payload.empty()) {
+                        break;
+                    }
+                    worker_.reset(base_);
+                    append_result(0);
+                    return ok;
+                }
+                case injections: {
+                    constexpr auto record_size = 2 * sizeof(std::uint32_t) + 4 * sizeof(double);
+                    if (payload.size() % record_size) {
+                        break;
+                    }
+                    worker_.reset(base_);
+                    for (auto ptr = payload.data(); ptr != payload.data() + payload.size(); ptr += record_size) {
+                        std::uint32_t id;
+                        double values[4];
+                        std::memcpy(&id, ptr, sizeof id);
+                        std::memcpy(values, ptr + 2 * sizeof(std::uint32_t), sizeof values);
+                        worker_.update_node(id, values[0], values[1], values[2], values[3]);
+                    }
+                    worker_.snapshot_init();
+                    unsigned n_iter;
+                    if (!converge(n_iter)) {
+                        return not_converged;
+                    }
+                    append_result(n_iter);
+                    return ok;
+                }
+                case fault: {
+                    if (payload.size() != 2 * sizeof(std::uint32_t) + 2 * sizeof(double)) {
+                        break;
+                    }
+                    if (!short_circuit_) {
+                        throw calc_error("Short circuit calculation is not enabled.");
+                    }
+                    std::uint32_t id;
+                    double z_f[2];
+                    std::memcpy(&id, payload.data(), sizeof id);
+                    std::memcpy(z_f, payload.data() + 2 * sizeof(std::uint32_t), sizeof z_f);
+                    // Factorization of the modified node admittance matrix is reused.
+                    base_.short_circuit_fault(id, { z_f[0], z_f[1] });
+                    const auto i_f = base_.short_circuit_current();
+                    const double i_f_parts[] = { i_f.real(), i_f.imag() };
+                    append(i_f_parts, sizeof i_f_parts);
+                    const arma::mat u_f = base_.short_circuit_voltage().t();
+                    append(u_f.memptr(), u_f.n_elem * sizeof(double));
+                    const arma::mat i = base_.short_circuit_edge_current().t();
+                    append(i.memptr(), i.n_elem * sizeof(double));
+                    return ok;
+                }
+                case outage: {
+                    if (payload.size() != 2 * sizeof(std::uint32_t)) {
+                        break;
+                    }
+                    std::uint32_t edge;
+                    std::memcpy(&edge, payload.data(), sizeof edge);
+                    if (edge < 1 || edge > worker_.num_edges()) {
+                        throw calc_error("Bad edge offset for outage.");
+                    }
+                    if (islanding_[edge - 1]) {
+                        return islanding;
+                    }
+                    worker_.reset(base_);
+                    unsigned n_iter;
+                    if (!worker_.solve_outage(edge - 1, base_, max_, n_iter)) {
+                        return not_converged;
+                    }
+                    append_result(n_iter);
+                    return ok;
+                }
+                default:
+                    break;
+            }
+            throw calc_error("Bad request.");
+        }
+        catch (const calc_error& e) {
+            response_.clear();
+            append(e.what(), std::strlen(e.what()));
+            return bad_request;
+        }
+    }
+
+    void server::serve_connection(int fd)
+    {
+#ifndef _WIN32
+        std::vector<char> payload;
+        header head;
+        while (!stop_ && read_all(fd, &head, sizeof head)) {
+            if (head.size > max_request_size) {
+                return;
+            }
+            payload.resize(head.size);
+            if (!read_all(fd, payload.data(), payload.size())) {
+                return;
+            }
+            const header response_head = { handle(head.type, payload),
+                static_cast<std::uint32_t>(response_.size()) };
+            if (!write_all(fd, &response_head, sizeof response_head) ||
+                !write_all(fd, response_.data(), response_.size())) {
+                return;
+            }
+        }
+#endif // _WIN32
+    }
+
+    bool server::run(const std::string& path)
+    {
+#ifdef _WIN32
+        writer::notice("Serving over Unix domain socket is not supported on this platform.");
+        return false;
+#else
+        sockaddr_un addr = { };
+        addr.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof addr.sun_path) {
+            return false;
+        }
+        std::strcpy(addr.sun_path, path.c_str());
+        const auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd == -1) {
+            return false;
+        }
+        // Socket file left by a previous run is replaced, but not any other kind of file.
+        struct stat status;
+        if (lstat(path.c_str(), &status) == 0) {
+            if (!S_ISSOCK(status.st_mode)) {
+                writer::notice("Not a socket, refusing to replace: ", path);
+                ::close(fd);
+                return false;
+            }
+            unlink(path.c_str());
+        }
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) == -1 || listen(fd, 16) == -1) {
+            ::close(fd);
+            return false;
+        }
+        // Without SA_RESTART, blocking calls are interrupted on signal, so that we can stop.
+        struct sigaction action = { };
+        action.sa_handler = on_signal;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+        std::signal(SIGPIPE, SIG_IGN);
+        writer::println("Serving on ", path, ".");
+        while (!stop_) {
+            const auto conn = accept(fd, nullptr, nullptr);
+            if (conn == -1) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                break;
+            }
+            serve_connection(conn);
+            ::close(conn);
+        }
+        ::close(fd);
+        unlink(path.c_str());
+        writer::println("Stopped serving.");
+        return true;
+#endif // _WIN32
+    }
+}
@@ -0,0 +1,148 @@
+//
+// arma-flow/server.hpp
+//
+// @author CismonX
+//
+
+#pragma once
+
+#include "calc.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace flow
+{
+    /// Answers what-if requests on a loaded case over a Unix domain socket.
+    ///
+    /// Each request and response begins with a header of two 32-bit unsigned integers (in native
+    /// byte order), followed by a payload of the given size. Requests are handled one at a time,
+    /// each starting from the converged base case, so that node admittance matrix and symbolic
+    /// analysis (and factorization for short circuit) are kept across requests.
+    class server
+    {
+    public:
+        /// Type of request.
+        enum request_type : std::uint32_t {
+            /// Result of base case. No payload.
+            base = 0,
+            /// Solve with new injections. Payload is an array of nodes, each of which is
+            /// node ID (uint32), padding (uint32), and voltage, generator power, load power
+            /// (active and reactive) (double).
+            injections = 1,
+            /// Three-phase short circuit. Payload is node ID (uint32), padding (uint32), and
+            /// transition impedance (real and imaginary part, double).
+            fault = 2,
+            /// Solve with an edge out of service. Payload is edge offset (uint32, start at 1),
+            /// and padding (uint32).
+            outage = 3
+        };
+
+        /// Status of response.
+        enum response_status : std::uint32_t {
+            /// Success.
+            ok = 0,
+            /// Calculation does not converge.
+            not_converged = 1,
+            /// Outage splits the network into islands.
+            islanding = 2,
+            /// Bad request. Payload is the error message.
+            bad_request = 3
+        };
+
+    private:
+        /// Header of request and response.
+        struct header
+        {
+            /// Type of request, or status of response.
+            std::uint32_t type;
+
+            /// Size of payload in bytes.
+            std::uint32_t size;
+        };
+
+        /// Max size of request payload.
+        static constexpr std::uint32_t max_request_size = 1 << 26;
+
+        /// The converged base case.
+        calc& base_;
+
+        /// Copy of base case, on which requests are calculated.
+        calc worker_;
+
+        /// Max number of iterations.
+        unsigned max_;
+
+        /// Accuracy of calculation.
+        double epsilon_;
+
+        /// Whether short circuit calculation is available.
+        bool short_circuit_;
+
+        /// Whether each edge is a bridge, whose outage splits the network into islands.
+        std::vector<bool> islanding_;
+
+        /// Payload of current response.
+        std::vector<char> response_;
+
+        /**
+         * Append values to response payload.
+         *
+         * @param data Values to be appended.
+         * @param size Size in bytes.
+         */
+        void append(const void* data, std::size_t size);
+
+        /**
+         * Append iteration count and result of worker to response payload.
+         *
+         * @param n_iter Number of iterations.
+         */
+        void append_result(unsigned n_iter);
+
+        /**
+         * Iterate on worker until converged.
+         *
+         * @param n_iter Number of iterations done.
+         * @return Whether calculation converges.
+         */
+        bool converge(unsigned& n_iter);
+
+        /**
+         * Handle a request.
+         *
+         * @param type Type of request.
+         * @param payload Payload of request.
+         * @return Status of response, whose payload is written to response_.
+         */
+        std::uint32_t handle(std::uint32_t type, const std::vector<char>& payload);
+
+        /**
+         * Serve a connection until it is closed by client.
+         *
+         * @param fd File descriptor of connection.
+         */
+        void serve_connection(int fd);
+
+    public:
+        /**
+         * Constructor.
+         *
+         * @param base The converged base case, with result() called (and short_circuit_init()
+         *             if short circuit calculation is available).
+         * @param max Max number of iterations for each request.
+         * @param epsilon Accuracy of calculation.
+         * @param short_circuit Whether short circuit calculation is available.
+         */
+        explicit server(calc& base, unsigned max, double epsilon, bool short_circuit);
+
+        /**
+         * Listen on a Unix domain socket and serve until SIGINT or SIGTERM is received.
+         *
+         * @param path Path to socket, which is removed on exit.
+         * @return Whether socket is successfully created.
+         */
+        bool run(const std::string& path);
+    };
+}
@@ -0,0 +1,81 @@
+//
+// arma-flow/solver.cpp
+//
+// @author CismonX
+//
+
+#include "solver.hpp"
+
+namespace flow
+{
+    void solver::load(const double* nodes, unsigned num_nodes, const double* edges, unsigned num_edges)
+    {
+        if (!nodes || !edges) {
+            throw calc_error("Bad input matrix format.");
+        }
+        // Caller memory is used in place. It is never written, despite the const_cast.
+        const arma::mat nodes_mat(const_cast<double*>(nodes), num_nodes, options_.node_id ? 6 : 5, false, true);
+        const arma::mat edges_mat(const_cast<double*>(edges), num_edges, 6, false, true);
+        calc_.reset();
+        iterated_ = converged_ = false;
+        auto new_calc = std::make_unique<calc>();
+        new_calc->init(nodes_mat, edges_mat, options_.node_id, options_.method, false, options_.epsilon,
+            false, false, {}, {});
+        new_calc->set_threads(options_.threads);
+        new_calc->set_mixed_precision(options_.mixed_precision);
+        new_calc->admittance_init();
+        calc_ = std::move(new_calc);
+        num_nodes_ = num_nodes;
+    }
+
+    void solver::update_node(unsigned id, double v, double g, double p, double q)
+    {
+        if (!calc_) {
+            throw calc_error("No case is loaded.");
+        }
+        calc_->update_node(id, v, g, p, q);
+    }
+
+    void solver::switch_edge(unsigned edge, bool in_service, double k)
+    {
+        if (!calc_) {
+            throw calc_error("No case is loaded.");
+        }
+        if (!edge) {
+            throw calc_error("Bad edge offset for switching.");
+        }
+        calc_->switch_edge(edge - 1, in_service, k);
+    }
+
+    unsigned solver::solve()
+    {
+        if (!calc_) {
+            throw calc_error("No case is loaded.");
+        }
+        if (converged_) {
+            calc_->snapshot_init();
+        } else {
+            calc_->iterate_init();
+            iterated_ = true;
+        }
+        converged_ = false;
+        unsigned num_iterations;
+        do {
+            num_iterations = calc_->solve();
+            if (calc_->get_max() <= options_.epsilon) {
+                converged_ = true;
+                return num_iterations;
+            }
+        } while (num_iterations < options_.max_iterations);
+        return 0;
+    }
+
+    void solver::result(double* out)
+    {
+        if (!iterated_) {
+            throw calc_error("No case is solved.");
+        }
+        arma::mat out_mat(out, num_nodes_, 4, false, true);
+        out_mat = calc_->result();
+    }
+}
@@ -0,0 +1,139 @@
+//
+// arma-flow/solver.hpp
+//
+// @author CismonX
+//
+
+#pragma once
+
+#include "calc.hpp"
+#include "calc_error.hpp"
+
+#include <memory>
+
+namespace flow
+{
+    /// Power flow solver for embedding in other programs (built as libarmaflow).
+    ///
+    /// Each instance is independent, and different instances can be used from different
+    /// threads concurrently. Node data and edge data are read in place from caller memory, and
+    /// copied once into the columns of the calculation (which update_node() and switch_edge()
+    /// modify), so that caller memory can be released after load(). Errors are reported by
+    /// throwing calc_error.
+    class solver
+    {
+    public:
+        /// Options of calculation.
+        struct options
+        {
+            /// Method of power flow calculation.
+            calc::method_type method = calc::newton;
+
+            /// Max number of iterations.
+            unsigned max_iterations = 100;
+
+            /// Accuracy of calculation.
+            double epsilon = 0.00001;
+
+            /// Whether first column of node data is node ID.
+            bool node_id = false;
+
+            /// Number of threads for evaluating jacobian matrix and mismatches (0 for number
+            /// of hardware threads).
+            unsigned threads = 1;
+
+            /// Whether jacobian matrix is factorized in single precision, with iterative
+            /// refinement (for very large networks).
+            bool mixed_precision = false;
+        };
+
+    private:
+        /// Options of calculation.
+        options options_;
+
+        /// The power flow calculator of the loaded case.
+        std::unique_ptr<calc> calc_;
+
+        /// Number of nodes.
+        unsigned num_nodes_ = 0;
+
+        /// Whether iteration is initialized.
+        bool iterated_ = false;
+
+        /// Whether the last solve converged (so that the next solve starts from its solution).
+        bool converged_ = false;
+
+    public:
+        /**
+         * Default constructor.
+         */
+        explicit solver() = default;
+
+        /**
+         * Constructor.
+         *
+         * @param opts Options of calculation.
+         */
+        explicit solver(const options& opts) : options_(opts) {}
+
+        /**
+         * Load a case. Previously loaded case is discarded.
+         *
+         * Arrays are in column-major order (column by column), with the same columns as node
+         * data file and edge data file (without short circuit columns). They are only read
+         * during this call.
+         *
+         * @param nodes Node data, num_nodes * 5 (or 6 if node ID is given).
+         * @param num_nodes Number of nodes.
+         * @param edges Edge data, num_edges * 6.
+         * @param num_edges Number of edges.
+         */
+        void load(const double* nodes, unsigned num_nodes, const double* edges, unsigned num_edges);
+
+        /**
+         * Update power injections and voltage set point of a node. The next solve starts
+         * from the last solution, with node admittance matrix and symbolic analysis kept.
+         *
+         * @param id Node ID (or row offset of node data, start at 1).
+         * @param v Node voltage.
+         * @param g Generator power (active).
+         * @param p Load power (active).
+         * @param q Load power (reactive).
+         */
+        void update_node(unsigned id, double v, double g, double p, double q);
+
+        /**
+         * Switch an edge in or out of service, or change its transformer ratio. Node admittance
+         * matrix and existing factorizations are updated in place, and the next solve starts
+         * from the last solution.
+         *
+         * @param edge Row offset of edge data (start at 1).
+         * @param in_service Whether edge is in service.
+         * @param k Transformer ratio (0 if edge has no transformer).
+         */
+        void switch_edge(unsigned edge, bool in_service, double k);
+
+        /**
+         * Solve power flow of the loaded case.
+         *
+         * @return Number of iterations (0 if exceeds max number of iterations).
+         */
+        unsigned solve();
+
+        /**
+         * Get result of the last solve.
+         *
+         * @param out Buffer of num_nodes * 4 elements, to which V, theta (in rads), P and Q of
+         *            each node are written in column-major order, in original node order.
+         */
+        void result(double* out);
+
+        /**
+         * Get number of nodes of the loaded case.
+         */
+        unsigned num_nodes() const
+        {
+            return num_nodes_;
+        }
+    };
+}
@@ -0,0 +1,79 @@
+//
+// arma-flow/thread_pool.cpp
+//
+// @author CismonX
+//
+
+#include "thread_pool.hpp"
+
+namespace flow
+{
+    void thread_pool::work(unsigned thread, unsigned long long round)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            wake_.wait(lock, [this, round]
+            {
+                return stop_ || round_ != round;
+            });
+            if (stop_) {
+                return;
+            }
+            round = round_;
+            const auto task = task_;
+            lock.unlock();
+            (*task)(thread);
+            lock.lock();
+            if (!--running_) {
+                done_.notify_one();
+            }
+        }
+    }
+
+    void thread_pool::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto&& thread : threads_) {
+            thread.join();
+        }
+        threads_.clear();
+        stop_ = false;
+    }
+
+    void thread_pool::run(const std::function<void(unsigned)>& task)
+    {
+        if (threads_.empty()) {
+            threads_.reserve(size_ - 1);
+            for (auto thread = 1U; thread < size_; ++thread) {
+                threads_.emplace_back(&thread_pool::work, this, thread, round_);
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            task_ = &task;
+            running_ = static_cast<unsigned>(threads_.size());
+            ++round_;
+        }
+        wake_.notify_all();
+        task(0);
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this]
+        {
+            return !running_;
+        });
+        task_ = nullptr;
+    }
+
+    void thread_pool::resize(unsigned size)
+    {
+        size = size ? size : 1;
+        if (size != size_) {
+            stop();
+            size_ = size;
+        }
+    }
+}
@@ -0,0 +1,159 @@
+//
+// arma-flow/thread_pool.hpp
+//
+// @author CismonX
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace flow
+{
+    /// Persistent threads which run tasks in rounds, so that threads are not created and joined
+    /// for each round (e.g. on each iteration). Threads are started on first use.
+    ///
+    /// A pool is used by one caller at a time. Copying a pool gives a new one of the same size,
+    /// which does not share threads with the original.
+    class thread_pool
+    {
+        /// Threads of the pool, excluding the calling thread, which also runs tasks.
+        std::vector<std::thread> threads_;
+
+        /// Number of threads running each round, including the calling thread.
+        unsigned size_;
+
+        /// Mutex guarding the state below.
+        std::mutex mutex_;
+
+        /// Notified when a round starts, or when threads should stop.
+        std::condition_variable wake_;
+
+        /// Notified when all threads of the pool finish the current round.
+        std::condition_variable done_;
+
+        /// Task of the current round, called with index of thread.
+        const std::function<void(unsigned)>* task_ = nullptr;
+
+        /// Number of rounds started.
+        unsigned long long round_ = 0;
+
+        /// Number of threads of the pool still running the current round.
+        unsigned running_ = 0;
+
+        /// Whether threads should stop.
+        bool stop_ = false;
+
+        /**
+         * Run tasks of each round, until stopped.
+         *
+         * @param thread Index of thread.
+         * @param round Number of rounds started before the thread, which are not run.
+         */
+        void work(unsigned thread, unsigned long long round);
+
+        /**
+         * Stop and join threads of the pool.
+         */
+        void stop();
+
+        /**
+         * Run a round, with the calling thread as thread 0, and wait until all threads finish.
+         *
+         * @param task Task to be called by each thread, which should not throw.
+         */
+        void run(const std::function<void(unsigned)>& task);
+
+    public:
+        /**
+         * Constructor.
+         *
+         * @param size Number of threads, including the calling thread.
+         */
+        explicit thread_pool(unsigned size = 1) : size_(size ? size : 1) {}
+
+        /**
+         * Copy constructor. Threads are not shared.
+         */
+        thread_pool(const thread_pool& other) : size_(other.size_) {}
+
+        /**
+         * Copy assignment. Threads are not shared.
+         */
+        thread_pool& operator=(const thread_pool& other)
+        {
+            resize(other.size_);
+            return *this;
+        }
+
+        /**
+         * Destructor.
+         */
+        ~thread_pool()
+        {
+            stop();
+        }
+
+        /**
+         * Change number of threads. Existing threads are stopped if number changes.
+         *
+         * @param size Number of threads, including the calling thread.
+         */
+        void resize(unsigned size);
+
+        /**
+         * Get number of threads, including the calling thread.
+         */
+        unsigned size() const
+        {
+            return size_;
+        }
+
+        /**
+         * Run a task for each index in [0, count) with threads of the pool, same as
+         * parallel::for_each(). Indices are dispatched dynamically. If any task throws,
+         * the first exception is rethrown after all threads finish.
+         *
+         * @param count Number of tasks.
+         * @param func Callback for each task, with the index of task and thread.
+         */
+        template <typename F>
+        void for_each(unsigned count, F func)
+        {
+            if (size_ <= 1 || count <= 1) {
+                for (auto i = 0U; i < count; ++i) {
+                    func(i, 0U);
+                }
+                return;
+            }
+            std::atomic<unsigned> next(0);
+            std::exception_ptr exception;
+            std::mutex mutex;
+            const std::function<void(unsigned)> task = [&](unsigned thread)
+            {
+                try {
+                    for (auto i = next++; i < count; i = next++) {
+                        func(i, thread);
+                    }
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!exception) {
+                        exception = std::current_exception();
+                    }
+                    // Skip remaining tasks.
+                    next = count;
+                }
+            };
+            run(task);
+            if (exception) {
+                std::rethrow_exception(exception);
+            }
+        }
+    };
+}
@@ -5,98 +5,303 @@
 //
 
 #include "writer.hpp"
+#include "case_format.hpp"
+#include "parallel.hpp"
 
-#ifdef _WIN32
-#include <Windows.h>
-#else
-#include <sys/ioctl.h>
-#endif // _WIN32
-#include <iomanip>
 #include <experimental/filesystem>
 
 namespace flow
 {
-    int writer::max_elems_per_line()
+    void writer::append_double(std::string& str, double val)
     {
-#ifdef _WIN32
-        CONSOLE_SCREEN_BUFFER_INFO csbi;
-        if (!GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi)) {
-            return 10;
+        char buffer[output_buffer::max_double_length];
+        str.append(buffer, output_buffer::format_double(buffer, val));
+    }
+
+    void writer::append_uint(std::string& str, unsigned long long val)
+    {
+        char buffer[20];
+        str.append(buffer, output_buffer::format_uint(buffer, val));
+    }
+
+    void writer::format_rows(std::string& str, const arma::mat& mat, arma::uword first, arma::uword last)
+    {
+        for (auto row = first; row < last; ++row) {
+            for (auto col = 0U; col < mat.n_cols; ++col) {
+                if (col) {
+                    str += ',';
+                }
+                append_double(str, mat.at(row, col));
+            }
+            str += '\n';
         }
-        const auto width = csbi.dwSize.X;
-#else
-        winsize win;
-        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &win) == -1) {
-            return 10;
+    }
+
+    void writer::format_sp_cols(std::string& str, const arma::sp_mat& trans, arma::uword first, arma::uword last)
+    {
+        for (auto col = first; col < last; ++col) {
+            auto i = trans.col_ptrs[col];
+            for (auto row = 0U; row < trans.n_rows; ++row) {
+                if (row) {
+                    str += ',';
+                }
+                if (i < trans.col_ptrs[col + 1] && trans.row_indices[i] == row) {
+                    append_double(str, trans.values[i++]);
+                } else {
+                    str += '0';
+                }
+            }
+            str += '\n';
         }
-        const auto width = win.ws_col;
+    }
+
+    std::string writer::real_path(const std::string& path) const
+    {
+        namespace fs = std::experimental::filesystem;
+        const auto real_path = output_path_prefix_ + path;
+        return
+#ifdef _WIN32
+            real_path[1] == ':'
+#else
+            real_path[0] == '/'
 #endif // _WIN32
-        return std::floor((width - 7) / 11);
+            ? real_path : fs::current_path().string() + '/' + real_path;
     }
 
-    std::string writer::double_to_string(double val)
+    template <typename F>
+    void writer::write_chunks(output_buffer& out, arma::uword n_rows, arma::uword n_cols, F format) const
     {
-        auto str = std::to_string(val ? val : std::abs(val));
-        auto pos = str.find_last_not_of('0');
-        if (pos == 0 || str[pos] == '.') {
-            --pos;
+        // Each chunk holds roughly the same number of elements.
+        const arma::uword chunk_elems = 1 << 16;
+        const auto rows_per_chunk = std::max<arma::uword>(1, chunk_elems / std::max<arma::uword>(1, n_cols));
+        const auto n_chunks = (n_rows + rows_per_chunk - 1) / rows_per_chunk;
+        const auto threads = std::min<arma::uword>(parallel::threads(threads_), std::max<arma::uword>(1, n_chunks));
+        // Chunks are formatted in rounds of one chunk per thread, and written in order. Buffers
+        // of chunks are reused across rounds.
+        std::vector<std::string> chunks(threads);
+        for (arma::uword round = 0; round < n_chunks; round += threads) {
+            const auto count = static_cast<unsigned>(std::min<arma::uword>(threads, n_chunks - round));
+            parallel::for_each(count, count, [&](unsigned chunk, unsigned)
+            {
+                const auto first = (round + chunk) * rows_per_chunk;
+                chunks[chunk].clear();
+                format(chunks[chunk], first, std::min(first + rows_per_chunk, n_rows));
+            });
+            for (auto chunk = 0U; chunk < count; ++chunk) {
+                out.write(chunks[chunk]);
+            }
         }
-        return str.substr(0, pos + 1);
     }
 
-    void writer::print_mat(const arma::mat& mat)
+    template <typename F>
+    void writer::write_file(const std::string& path, const std::string& header, F func) const
     {
-        mat.each_row([](const arma::rowvec& row)
+        output_buffer out;
+        try {
+            if (!out.open(real_path(path), parallel::threads(threads_) > 1)) {
+                error("Failed to write to file.");
+            }
+        }
+        catch (const std::exception&) {
+            error("Failed to write to file.");
+        }
+        if (header.length()) {
+            out.write(header + '\n');
+        }
+        func(out);
+        if (!out.close()) {
+            error("Failed to write to file.");
+        }
+    }
+
+    void writer::to_csv_file(const std::string& path, const arma::mat& mat, const std::string& header) const
+    {
+        write_file(path, header, [&mat, this](output_buffer& out)
         {
-            std::cout << std::left;
-            auto counter = 0;
-            auto elems = max_elems_per_line();
-            for (auto&& elem : row) {
-                if (++counter > elems) {
-                    std::cout << "...(" << row.n_elem - elems << ')';
-                    break;
+            write_chunks(out, mat.n_rows, mat.n_cols, [&mat](std::string& str, arma::uword first, arma::uword last)
+            {
+                format_rows(str, mat, first, last);
+            });
+        });
+    }
+
+    void writer::to_text_file(const std::string& path, const std::string& content) const
+    {
+        write_file(path, "", [&content](output_buffer& out)
+        {
+            out.write(content);
+        });
+    }
+
+    void writer::to_mm_file(const std::string& path, const arma::sp_cx_mat& mat) const
+    {
+        std::string header = "%%MatrixMarket matrix coordinate complex general\n";
+        append_uint(header, mat.n_rows);
+        header += ' ';
+        append_uint(header, mat.n_cols);
+        header += ' ';
+        append_uint(header, mat.n_nonzero);
+        // Indices start at 1. Elements are written column by column.
+        const auto elems_per_col = std::max<arma::uword>(1, mat.n_nonzero / std::max<arma::uword>(1, mat.n_cols));
+        write_file(path, header, [&mat, elems_per_col, this](output_buffer& out)
+        {
+            write_chunks(out, mat.n_cols, 4 * elems_per_col, [&mat](std::string& str, arma::uword first, arma::uword last)
+            {
+                for (auto col = first; col < last; ++col) {
+                    for (auto i = mat.col_ptrs[col]; i < mat.col_ptrs[col + 1]; ++i) {
+                        const std::complex<double> elem = mat.values[i];
+                        append_uint(str, mat.row_indices[i] + 1);
+                        str += ' ';
+                        append_uint(str, col + 1);
+                        str += ' ';
+                        append_double(str, elem.real());
+                        str += ' ';
+                        append_double(str, elem.imag());
+                        str += '\n';
+                    }
                 }
-                std::cout << std::setw(10) << double_to_string(elem) << ' ';
-            }
-            std::cout << std::endl;
+            });
         });
     }
 
-    void writer::print_complex(const std::string& prefix, const std::complex<double>& complex)
+    void writer::to_mm_file(const std::string& path, const arma::cx_mat& mat) const
     {
-        std::cout << prefix << complex.real() << (complex.imag() < 0 ? '-' : '+') <<
-            'j' << std::abs(complex.imag()) << std::endl;
+        std::string header = "%%MatrixMarket matrix array complex general\n";
+        append_uint(header, mat.n_rows);
+        header += ' ';
+        append_uint(header, mat.n_cols);
+        // Elements are written in column-major order.
+        write_file(path, header, [&mat, this](output_buffer& out)
+        {
+            write_chunks(out, mat.n_cols, 2 * mat.n_rows, [&mat](std::string& str, arma::uword first, arma::uword last)
+            {
+                for (auto col = first; col < last; ++col) {
+                    for (auto row = 0U; row < mat.n_rows; ++row) {
+                        const auto elem = mat.at(row, col);
+                        append_double(str, elem.real());
+                        str += ' ';
+                        append_double(str, elem.imag());
+                        str += '\n';
+                    }
+                }
+            });
+        });
     }
 
-    void writer::to_csv_file(const std::string& path, const arma::mat& mat, const std::string& header) const
+    void writer::to_triplet_file(const std::string& path, const arma::sp_cx_mat& mat, const std::vector<unsigned>& ids) const
     {
-        std::ofstream ofstream;
-        ofstream.exceptions(std::ifstream::failbit);
-        namespace fs = std::experimental::filesystem;
-        try {
-            const auto real_path = output_path_prefix_ + path;
-            ofstream.open(
-#ifdef _WIN32
-                real_path[1] == ':'
-#else
-                real_path[0] == '/'
-#endif // _WIN32
-                ? real_path : fs::current_path().string() + '/' + real_path);
-            if (header.length())
-                ofstream << header << std::endl;
-            mat.each_row([&ofstream](const arma::rowvec& row)
+        const auto elems_per_col = std::max<arma::uword>(1, mat.n_nonzero / std::max<arma::uword>(1, mat.n_cols));
+        write_file(path, "row,col,real,imag", [&mat, &ids, elems_per_col, this](output_buffer& out)
+        {
+            write_chunks(out, mat.n_cols, 4 * elems_per_col, [&mat, &ids](std::string& str, arma::uword first, arma::uword last)
             {
-                for (auto col = 0U; col < row.n_elem; ++col) {
-                    ofstream << double_to_string(row[col]);
-                    if (col != row.n_elem - 1) {
-                        ofstream << ',';
+                for (auto col = first; col < last; ++col) {
+                    for (auto i = mat.col_ptrs[col]; i < mat.col_ptrs[col + 1]; ++i) {
+                        const std::complex<double> elem = mat.values[i];
+                        append_uint(str, ids[mat.row_indices[i]]);
+                        str += ',';
+                        append_uint(str, ids[col]);
+                        str += ',';
+                        append_double(str, elem.real());
+                        str += ',';
+                        append_double(str, elem.imag());
+                        str += '\n';
                     }
                 }
-                ofstream << std::endl;
             });
+        });
+    }
+
+    void writer::to_case_file(
+        const std::string&      path,
+        const arma::mat&        nodes,
+        const arma::mat&        edges,
+        bool                    node_id,
+        const arma::uvec&       order,
+        const arma::sp_cx_mat&  n_adm)
+    {
+        auto header = case_header::create();
+        header.node_rows = nodes.n_rows;
+        header.node_cols = nodes.n_cols;
+        header.edge_rows = edges.n_rows;
+        header.edge_cols = edges.n_cols;
+        if (node_id) {
+            header.flags |= case_header::has_node_id;
+        }
+        const auto with_n_adm = n_adm.n_rows == nodes.n_rows && order.n_elem == nodes.n_rows;
+        if (with_n_adm) {
+            header.flags |= case_header::has_node_admittance;
+            header.y_nnz = n_adm.n_nonzero;
+        }
+        const auto write = [](std::ofstream& ofstream, const void* data, std::size_t size)
+        {
+            ofstream.write(static_cast<const char*>(data), size);
+        };
+        const auto write_uwords = [&write](std::ofstream& ofstream, const arma::uword* data, std::size_t n)
+        {
+            const std::vector<std::uint64_t> buffer(data, data + n);
+            write(ofstream, buffer.data(), n * sizeof(std::uint64_t));
+        };
+        std::ofstream ofstream;
+        ofstream.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try {
+            ofstream.open(path, std::ios::binary);
+            write(ofstream, &header, sizeof header);
+            // Matrices are stored in column-major order, same as in memory.
+            write(ofstream, nodes.memptr(), nodes.n_elem * sizeof(double));
+            write(ofstream, edges.memptr(), edges.n_elem * sizeof(double));
+            if (with_n_adm) {
+                write_uwords(ofstream, order.memptr(), order.n_elem);
+                write_uwords(ofstream, n_adm.col_ptrs, n_adm.n_cols + 1);
+                write_uwords(ofstream, n_adm.row_indices, n_adm.n_nonzero);
+                write(ofstream, n_adm.values, n_adm.n_nonzero * sizeof(std::complex<double>));
+            }
         }
         catch (const std::exception&) {
             error("Failed to write to file.");
         }
     }
+
+    void writer::open_stream(const std::string& path, const std::string& header)
+    {
+        try {
+            if (!stream_.open(real_path(path), parallel::threads(threads_) > 1)) {
+                error("Failed to write to file.");
+            }
+        }
+        catch (const std::exception&) {
+            error("Failed to write to file.");
+        }
+        if (header.length()) {
+            stream_.write(header + '\n');
+        }
+    }
+
+    void writer::append_to_stream(const arma::mat& mat)
+    {
+        write_chunks(stream_, mat.n_rows, mat.n_cols, [&mat](std::string& str, arma::uword first, arma::uword last)
+        {
+            format_rows(str, mat, first, last);
+        });
+    }
+
+    void writer::close_stream()
+    {
+        if (!stream_.close()) {
+            error("Failed to write to file.");
+        }
+    }
+
+    void writer::to_csv_file(const std::string& path, const arma::sp_mat& mat, const std::string& header) const
+    {
+        // Columns of the transposed matrix are rows of the original one.
+        const arma::sp_mat trans = mat.t();
+        write_file(path, header, [&trans, this](output_buffer& out)
+        {
+            write_chunks(out, trans.n_cols, trans.n_rows, [&trans](std::string& str, arma::uword first, arma::uword last)
+            {
+                format_sp_cols(str, trans, first, last);
+            });
+        });
+    }
 }
@@ -6,54 +6,91 @@
 
 #pragma once
 
+#include "output_buffer.hpp"
+#include "printer.hpp"
+
 #include <armadillo>
 
 namespace flow
 {
-    /// Provides write utilities.
-    class writer
+    /// Provides write utilities. Printing to stdout is inherited from printer.
+    class writer : public printer
     {
         /// Prefix of output file path.
         std::string output_path_prefix_;
 
+        /// Number of threads for formatting large matrices (0 for number of hardware threads).
+        unsigned threads_ = 0;
+
+        /// Output stream, to which results are appended.
+        output_buffer stream_;
+
         /**
-         * Determines width of stdout.
-         * 
-         * @return Character width.
+         * Get real path of an output file.
+         *
+         * @param path Path to output file.
+         * @return Path with prefix, relative to current directory if not absolute.
          */
-        static int max_elems_per_line();
+        std::string real_path(const std::string& path) const;
 
         /**
-         * Convert double to pretty string.
+         * Append a double to string in pretty format.
          * 
+         * @param str String to be appended to.
          * @param val Value to be converted.
-         * @return Converted string.
          */
-        static std::string double_to_string(double val);
+        static void append_double(std::string& str, double val);
 
-    public:
         /**
-         * Print a line to stdout.
-         * 
-         * @param message Messages to be printed.
+         * Append an unsigned integer to string.
+         *
+         * @param str String to be appended to.
+         * @param val Value to be converted.
          */
-        template <typename ...T>
-        static void println(T&&... message)
-        {
-            (std::cout << ... << message) << std::endl;
-        }
+        static void append_uint(std::string& str, unsigned long long val);
 
         /**
-         * Print a notice message to stdout.
-         * 
-         * @param message Messages to be printed.
+         * Format rows of a matrix in CSV format.
+         *
+         * @param str String to be appended to.
+         * @param mat Matrix to be formatted.
+         * @param first First row.
+         * @param last Past-the-end row.
          */
-        template <typename ...T>
-        static void notice(T&&... message)
-        {
-            (std::cout << "Notice: " << ... << message) << std::endl;
-        }
+        static void format_rows(std::string& str, const arma::mat& mat, arma::uword first, arma::uword last);
 
+        /**
+         * Format columns of a sparse matrix as rows in CSV format, zeros included.
+         *
+         * @param str String to be appended to.
+         * @param trans Transposed matrix to be formatted.
+         * @param first First column.
+         * @param last Past-the-end column.
+         */
+        static void format_sp_cols(std::string& str, const arma::sp_mat& trans, arma::uword first, arma::uword last);
+
+        /**
+         * Format rows of a matrix chunk by chunk (in parallel if large), and write them in order.
+         *
+         * @param out Output buffer.
+         * @param n_rows Number of rows.
+         * @param n_cols Number of columns.
+         * @param format Callback which formats rows in [first, last) into a string.
+         */
+        template <typename F>
+        void write_chunks(output_buffer& out, arma::uword n_rows, arma::uword n_cols, F format) const;
+
+        /**
+         * Open output file and write contents into it.
+         *
+         * @param path Path to output file.
+         * @param header Header of CSV file.
+         * @param func Callback which writes contents.
+         */
+        template <typename F>
+        void write_file(const std::string& path, const std::string& header, F func) const;
+
+    public:
         /**
          * Print a error message to stdout and terminate proogram.
          * 
@@ -77,24 +114,102 @@ namespace flow
         }
 
         /**
-         * Print a matrix to stdout.
-         * 
+         * Set number of threads for formatting large matrices and writing files in background.
+         *
+         * @param threads Number of threads (0 for number of hardware threads).
+         */
+        void set_threads(unsigned threads)
+        {
+            threads_ = threads;
+        }
+
+        /**
+         * Write a matrix to a file in CSV format.
+         *
+         * @param path Path to CSV file.
          * @param mat Matrix to be printed.
+         * @param header Header of CSV file
          */
-        static void print_mat(const arma::mat& mat);
+        void to_csv_file(const std::string& path, const arma::mat& mat, const std::string& header = "") const;
 
         /**
-         * Print a complex number to stdout.
+         * Write a sparse complex matrix to a file in MatrixMarket coordinate format.
+         *
+         * @param path Path to file.
+         * @param mat Matrix to be written.
          */
-        static void print_complex(const std::string& prefix, const std::complex<double>& complex);
+        void to_mm_file(const std::string& path, const arma::sp_cx_mat& mat) const;
 
         /**
-         * Write a matrix to a file in CSV format.
+         * Write a dense complex matrix to a file in MatrixMarket array format.
+         *
+         * @param path Path to file.
+         * @param mat Matrix to be written.
+         */
+        void to_mm_file(const std::string& path, const arma::cx_mat& mat) const;
+
+        /**
+         * Write non-zero elements of a sparse complex matrix to a file as CSV triplets.
+         *
+         * @param path Path to CSV file.
+         * @param mat Matrix to be written.
+         * @param ids ID of each row and column.
+         */
+        void to_triplet_file(const std::string& path, const arma::sp_cx_mat& mat, const std::vector<unsigned>& ids) const;
+
+        /**
+         * Write a string to a text file.
+         *
+         * @param path Path to file.
+         * @param content Content of file.
+         */
+        void to_text_file(const std::string& path, const std::string& content) const;
+
+        /**
+         * Write a binary case file. Output path prefix is not applied.
+         *
+         * @param path Path to case file.
+         * @param nodes Node table.
+         * @param edges Edge table.
+         * @param node_id Whether first column of node table is node ID.
+         * @param order Original node offset of each sorted node.
+         * @param n_adm Node admittance matrix in sorted node order (not written if empty).
+         */
+        static void to_case_file(
+            const std::string&      path,
+            const arma::mat&        nodes,
+            const arma::mat&        edges,
+            bool                    node_id,
+            const arma::uvec&       order,
+            const arma::sp_cx_mat&  n_adm);
+
+        /**
+         * Open a CSV file as output stream, to which results are appended.
+         *
+         * @param path Path to CSV file.
+         * @param header Header of CSV file
+         */
+        void open_stream(const std::string& path, const std::string& header = "");
+
+        /**
+         * Append a matrix to output stream in CSV format.
+         *
+         * @param mat Matrix to be appended.
+         */
+        void append_to_stream(const arma::mat& mat);
+
+        /**
+         * Flush and close output stream.
+         */
+        void close_stream();
+
+        /**
+         * Write a sparse matrix to a file in CSV format.
          *
          * @param path Path to CSV file.
          * @param mat Matrix to be printed.
          * @param header Header of CSV file
          */
-        void to_csv_file(const std::string& path, const arma::mat& mat, const std::string& header = "") const;
+        void to_csv_file(const std::string& path, const arma::sp_mat& mat, const std::string& header = "") const;
     };
 }
\ No newline at end of file
@@ -0,0 +1,106 @@
+#!/bin/sh
+#
+# arma-flow/tools/bench.sh
+#
+# Times each calculation stage of arma-flow over synthetic networks of given sizes,
+# and reports how time of each stage scales with number of nodes.
+#
+# usage: bench.sh [<num_nodes> ...]
+#
+# Environment variables:
+#   ARMA_FLOW      Path to arma-flow (defaults to ./arma-flow)
+#   GRID_GEN       Path to grid-gen (defaults to ./grid-gen)
+#   BENCH_DIR      Directory of generated networks and results (defaults to bench-results)
+#   BENCH_METHODS  Power flow methods (defaults to "newton polar fdlf")
+#   BENCH_TOPOLOGY Network topologies (defaults to "mesh radial")
+#   BENCH_ARGS     Extra arguments passed to arma-flow (e.g. "--threads 1")
+#
+
+ARMA_FLOW=${ARMA_FLOW:-./arma-flow}
+GRID_GEN=${GRID_GEN:-./grid-gen}
+BENCH_DIR=${BENCH_DIR:-bench-results}
+BENCH_METHODS=${BENCH_METHODS:-newton polar fdlf}
+BENCH_TOPOLOGY=${BENCH_TOPOLOGY:-mesh radial}
+SIZES=${*:-1000 10000 100000}
+
+mkdir -p "$BENCH_DIR" || exit 1
+SUMMARY="$BENCH_DIR/summary.csv"
+echo "topology,nodes,method,stage,count,total" > "$SUMMARY"
+
+for topology in $BENCH_TOPOLOGY; do
+    for size in $SIZES; do
+        network="$BENCH_DIR/$topology-$size-"
+        if [ ! -f "${network}nodes.csv" ] || [ ! -f "${network}edges.csv" ]; then
+            "$GRID_GEN" -n "$size" --topology "$topology" -o "$network" > /dev/null || exit 1
+        fi
+        for method in $BENCH_METHODS; do
+            prefix="$network$method-"
+            echo "Running $topology network of $size nodes with $method method..."
+            # Network matrices are not written, which are dense in CSV format.
+            if ! "$ARMA_FLOW" -n "${network}nodes.csv" -e "${network}edges.csv" -o "$prefix" \
+                --method "$method" --outputs flow --profile $BENCH_ARGS > "${prefix}log.txt"; then
+                echo "Failed. See ${prefix}log.txt for details."
+                continue
+            fi
+            # Each stage is on its own line in profile report.
+            sed -n 's/.*"name": "\([^"]*\)", "count": \([0-9]*\), "total": \([^,]*\),.*/\1,\2,\3/p' \
+                "${prefix}profile.json" | while IFS=, read -r stage count total; do
+                echo "$topology,$size,$method,$stage,$count,$total" >> "$SUMMARY"
+            done
+            total=$(sed -n 's/^  "total": \([^,]*\),$/\1/p' "${prefix}profile.json")
+            echo "$topology,$size,$method,total,1,$total" >> "$SUMMARY"
+        done
+    done
+done
+
+# Total time of each stage by size, and the exponent k of fitted time ~ nodes^k
+# (by least squares in log scale).
+awk -F, '
+NR > 1 {
+    key = $1 "," $3 "," $4
+    if (!(key in seen)) {
+        seen[key] = 1
+        keys[++num_keys] = key
+    }
+    if (!($2 in has_size)) {
+        has_size[$2] = 1
+        sizes[++num_sizes] = $2
+    }
+    time[key, $2] = $6
+}
+END {
+    for (i = 1; i <= num_sizes; ++i) {
+        for (j = i + 1; j <= num_sizes; ++j) {
+            if (sizes[j] + 0 < sizes[i] + 0) {
+                tmp = sizes[i]; sizes[i] = sizes[j]; sizes[j] = tmp
+            }
+        }
+    }
+    printf "\n%-8s %-8s %-20s", "topology", "method", "stage"
+    for (i = 1; i <= num_sizes; ++i) {
+        printf " %12s", sizes[i]
+    }
+    printf " %8s\n", "scaling"
+    for (k = 1; k <= num_keys; ++k) {
+        split(keys[k], fields, ",")
+        printf "%-8s %-8s %-20s", fields[1], fields[2], fields[3]
+        n = sx = sy = sxx = sxy = 0
+        for (i = 1; i <= num_sizes; ++i) {
+            if ((keys[k], sizes[i]) in time) {
+                t = time[keys[k], sizes[i]]
+                printf " %12.6f", t
+                if (t > 0) {
+                    x = log(sizes[i]); y = log(t)
+                    ++n; sx += x; sy += y; sxx += x * x; sxy += x * y
+                }
+            } else {
+                printf " %12s", "-"
+            }
+        }
+        if (n >= 2 && n * sxx != sx * sx) {
+            printf " %8.2f\n", (n * sxy - sx * sy) / (n * sxx - sx * sx)
+        } else {
+            printf " %8s\n", "-"
+        }
+    }
+}' "$SUMMARY"
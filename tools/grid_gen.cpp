@@ -0,0 +1,410 @@
+//
+// arma-flow/tools/grid_gen.cpp
+//
+// @author CismonX
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <janus.h>
+#include <numeric>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    /// Parameters of a synthetic network.
+    struct grid_options
+    {
+        /// Number of nodes.
+        unsigned num_nodes;
+
+        /// Whether the network is meshed (otherwise radial).
+        bool meshed;
+
+        /// Ratio of PV nodes among all nodes but the swing node.
+        double pv_ratio;
+
+        /// Number of extra (non-tree) edges per node, for meshed networks.
+        double density;
+
+        /// Ratio of transformers among all edges.
+        double transformer_ratio;
+
+        /// Whether to write generator admittance (for short circuit calculation).
+        bool generator_admittance;
+    };
+
+    /// An edge of the network.
+    struct grid_edge
+    {
+        /// Nodes of edge (row offset in node data, start at 0).
+        unsigned m, n;
+
+        /// Resistance, reactance and grounding admittance (divided by two).
+        double r, x, b;
+
+        /// Transformer ratio (0 for lines).
+        double k;
+    };
+
+    /// A node of the network.
+    struct grid_node
+    {
+        /// Node type (0 - swing node, 1 - PQ node, 2 - PV node).
+        int type;
+
+        /// Node voltage, generator power, and load power (active and reactive).
+        double v, g, p, q;
+
+        /// Generator reactance.
+        double xd;
+    };
+
+    /**
+     * Generate a synthetic network.
+     *
+     * Nodes are placed on a square lattice with jitter, and the swing node is at the center.
+     * A breadth-first spanning tree of the lattice (in random order) forms the radial network,
+     * to which edges between other neighbouring nodes are added for meshed networks. Line
+     * impedance is proportional to distance between nodes. Generators are spread over the
+     * network, and each of them balances load nearby, so that power flows mostly between nearby
+     * nodes, as in real grids.
+     *
+     * @param opts Parameters of network.
+     * @param rng Random number generator.
+     * @param nodes Generated nodes.
+     * @param edges Generated edges.
+     */
+    void generate(const grid_options& opts, std::mt19937_64& rng,
+        std::vector<grid_node>& nodes, std::vector<grid_edge>& edges)
+    {
+        std::uniform_real_distribution<double> uniform(0, 1);
+        auto rand = [&](double min, double max)
+        {
+            return min + (max - min) * uniform(rng);
+        };
+        const auto n = opts.num_nodes;
+        const auto width = static_cast<unsigned>(std::ceil(std::sqrt(static_cast<double>(n))));
+        std::vector<double> pos_x(n), pos_y(n);
+        for (auto i = 0U; i < n; ++i) {
+            pos_x[i] = i % width + rand(-0.3, 0.3);
+            pos_y[i] = i / width + rand(-0.3, 0.3);
+        }
+        auto neighbours = [n, width](unsigned i)
+        {
+            std::vector<unsigned> retval;
+            if (i % width) {
+                retval.push_back(i - 1);
+            }
+            if ((i + 1) % width && i + 1 < n) {
+                retval.push_back(i + 1);
+            }
+            if (i >= width) {
+                retval.push_back(i - width);
+            }
+            if (i + width < n) {
+                retval.push_back(i + width);
+            }
+            return retval;
+        };
+        auto add_edge = [&](unsigned m, unsigned k)
+        {
+            const auto dist = std::hypot(pos_x[m] - pos_x[k], pos_y[m] - pos_y[k]);
+            grid_edge edge { m, k, 0, 0, 0, 0 };
+            if (uniform(rng) < opts.transformer_ratio) {
+                edge.x = rand(0.02, 0.05);
+                edge.r = edge.x * rand(0.01, 0.05);
+                edge.k = rand(0.99, 1.01);
+            } else {
+                edge.x = 0.01 * dist * rand(0.8, 1.2);
+                edge.r = edge.x * rand(0.1, 0.3);
+                edge.b = edge.x * rand(0.1, 0.3);
+            }
+            edges.push_back(edge);
+        };
+        // Spanning tree.
+        auto swing = (width / 2) * width + width / 2;
+        if (swing >= n) {
+            swing = n / 2;
+        }
+        std::vector<bool> visited(n, false);
+        std::queue<unsigned> queue;
+        visited[swing] = true;
+        queue.push(swing);
+        edges.reserve(static_cast<std::size_t>(n * (1 + opts.density)));
+        while (!queue.empty()) {
+            const auto i = queue.front();
+            queue.pop();
+            auto next = neighbours(i);
+            std::shuffle(next.begin(), next.end(), rng);
+            for (auto j : next) {
+                if (!visited[j]) {
+                    visited[j] = true;
+                    add_edge(i, j);
+                    queue.push(j);
+                }
+            }
+        }
+        // Extra edges. Each node has about one neighbour not connected by tree edges.
+        if (opts.meshed) {
+            std::vector<std::pair<unsigned, unsigned>> candidates;
+            std::vector<std::vector<unsigned>> adjacent(n);
+            for (const auto& edge : edges) {
+                adjacent[edge.m].push_back(edge.n);
+                adjacent[edge.n].push_back(edge.m);
+            }
+            for (auto i = 0U; i < n; ++i) {
+                for (auto j : neighbours(i)) {
+                    if (j > i && std::find(adjacent[i].begin(), adjacent[i].end(), j) == adjacent[i].end()) {
+                        candidates.emplace_back(i, j);
+                    }
+                }
+            }
+            std::shuffle(candidates.begin(), candidates.end(), rng);
+            const auto num_extra = std::min<std::size_t>(candidates.size(),
+                static_cast<std::size_t>(opts.density * n));
+            for (auto i = 0U; i < num_extra; ++i) {
+                add_edge(candidates[i].first, candidates[i].second);
+            }
+        }
+        // Loads. Some nodes are only for transmission.
+        nodes.assign(n, { 1, 1, 0, 0, 0, 0 });
+        for (auto i = 0U; i < n; ++i) {
+            if (uniform(rng) < 0.8) {
+                nodes[i].p = rand(0.02, 0.1);
+                nodes[i].q = nodes[i].p * rand(0.2, 0.5);
+            }
+        }
+        nodes[swing].type = 0;
+        nodes[swing].v = 1.03;
+        nodes[swing].q = 0;
+        nodes[swing].xd = 0.1;
+        // Generators. Most of them are placed so that each node is within a few edges (along the
+        // spanning tree) from a generator, and the rest are placed randomly. Otherwise, long
+        // feeders without generators are likely to cause voltage collapse.
+        const auto num_pv = std::min<std::size_t>(n - 1,
+            static_cast<std::size_t>(std::round(opts.pv_ratio * (n - 1))));
+        std::vector<unsigned> offsets;
+        offsets.reserve(n);
+        if (num_pv) {
+            // Greedy cover of tree nodes within given distance, from leaves to root. Minimum
+            // distance with no more generators than required is found by binary search.
+            std::vector<int> far(n), near(n);
+            std::vector<unsigned> covers;
+            auto cover = [&](int dist)
+            {
+                covers.clear();
+                std::fill(far.begin(), far.end(), 0);
+                std::fill(near.begin(), near.end(), n);
+                for (auto i = n - 1; i-- > 0;) {
+                    const auto node = edges[i].n, parent = edges[i].m;
+                    if (near[node] + far[node] <= dist) {
+                        far[node] = -1;
+                    } else if (far[node] == dist) {
+                        covers.push_back(node);
+                        near[node] = 0;
+                        far[node] = -1;
+                    }
+                    if (far[node] >= 0) {
+                        far[parent] = std::max(far[parent], far[node] + 1);
+                    }
+                    near[parent] = std::min(near[parent], near[node] + 1);
+                }
+            };
+            auto min_dist = 1, max_dist = static_cast<int>(n);
+            while (min_dist < max_dist) {
+                const auto dist = (min_dist + max_dist) / 2;
+                cover(dist);
+                if (covers.size() > num_pv) {
+                    min_dist = dist + 1;
+                } else {
+                    max_dist = dist;
+                }
+            }
+            cover(min_dist);
+            offsets = covers;
+        }
+        std::vector<bool> is_pv(n, false);
+        for (auto i : offsets) {
+            is_pv[i] = true;
+        }
+        const auto num_covers = offsets.size();
+        for (auto i = 0U; i < n; ++i) {
+            if (i != swing && !is_pv[i]) {
+                offsets.push_back(i);
+            }
+        }
+        std::shuffle(offsets.begin() + num_covers, offsets.end(), rng);
+        for (auto i = 0U; i < num_pv; ++i) {
+            auto& node = nodes[offsets[i]];
+            node.type = 2;
+            node.v = rand(1.01, 1.03);
+            node.q = 0;
+            node.xd = rand(0.1, 0.3);
+        }
+        // Each generator supplies load of nodes nearest to it (by number of edges), as well as
+        // losses of edges in between, which are estimated by flow through a spanning forest
+        // rooted at generators. Otherwise, large networks are unlikely to converge, as power
+        // transferred to or from the swing node over long distance grows with number of nodes.
+        std::vector<std::vector<std::pair<unsigned, unsigned>>> adjacent(n);
+        for (auto i = 0U; i < edges.size(); ++i) {
+            adjacent[edges[i].m].emplace_back(edges[i].n, i);
+            adjacent[edges[i].n].emplace_back(edges[i].m, i);
+        }
+        std::vector<unsigned> parent(n, n), parent_edge(n), order;
+        order.reserve(n);
+        parent[swing] = swing;
+        queue.push(swing);
+        for (auto i = 0U; i < num_pv; ++i) {
+            parent[offsets[i]] = offsets[i];
+            queue.push(offsets[i]);
+        }
+        while (!queue.empty()) {
+            const auto i = queue.front();
+            queue.pop();
+            order.push_back(i);
+            for (auto [j, edge] : adjacent[i]) {
+                if (parent[j] == n) {
+                    parent[j] = i;
+                    parent_edge[j] = edge;
+                    queue.push(j);
+                }
+            }
+        }
+        // Flow is accumulated from leaves to roots.
+        std::vector<double> flow_p(n), flow_q(n);
+        for (auto i = 0U; i < n; ++i) {
+            flow_p[i] = nodes[i].p;
+            flow_q[i] = nodes[i].type == 1 ? nodes[i].q : 0;
+        }
+        for (auto iter = order.rbegin(); iter != order.rend(); ++iter) {
+            const auto i = *iter;
+            if (parent[i] == i) {
+                if (i != swing) {
+                    nodes[i].g = flow_p[i];
+                }
+                continue;
+            }
+            // Voltage is assumed to be 1 for estimation of losses.
+            const auto& edge = edges[parent_edge[i]];
+            const auto s_square = std::pow(flow_p[i], 2) + std::pow(flow_q[i], 2);
+            flow_p[parent[i]] += flow_p[i] + edge.r * s_square;
+            flow_q[parent[i]] += flow_q[i] + edge.x * s_square;
+        }
+    }
+
+    /**
+     * Append a double to string.
+     *
+     * @param str String to be appended to.
+     * @param val Value to be converted.
+     */
+    void append_double(std::string& str, double val)
+    {
+        char buffer[32];
+        auto length = std::snprintf(buffer, sizeof buffer, "%.6f", val);
+        // Trailing zeros (and the decimal point, if no decimal places remain) are removed.
+        while (length > 1 && buffer[length - 1] == '0') {
+            --length;
+        }
+        if (buffer[length - 1] == '.') {
+            --length;
+        }
+        str.append(buffer, length);
+    }
+
+    /**
+     * Write node data and edge data to CSV files.
+     *
+     * @param prefix Prefix of output file path.
+     * @param opts Parameters of network.
+     * @param nodes Nodes to be written.
+     * @param edges Edges to be written.
+     * @return Whether files are successfully written.
+     */
+    bool write(const std::string& prefix, const grid_options& opts,
+        const std::vector<grid_node>& nodes, const std::vector<grid_edge>& edges)
+    {
+        std::string str = opts.generator_admittance ? "U,Generator,P,Q,Xd,type\n" : "U,Generator,P,Q,type\n";
+        for (const auto& node : nodes) {
+            for (auto val : { node.v, node.g, node.p, node.q }) {
+                append_double(str, val);
+                str += ',';
+            }
+            if (opts.generator_admittance) {
+                append_double(str, node.xd);
+                str += ',';
+            }
+            str += static_cast<char>('0' + node.type);
+            str += '\n';
+        }
+        std::ofstream nodes_file(prefix + "nodes.csv", std::ios::binary);
+        if (!nodes_file.write(str.data(), str.size())) {
+            return false;
+        }
+        str = "n1,n2,R,X,B/2,k\n";
+        for (const auto& edge : edges) {
+            str += std::to_string(edge.m + 1) + ',' + std::to_string(edge.n + 1);
+            for (auto val : { edge.r, edge.x, edge.b, edge.k }) {
+                str += ',';
+                append_double(str, val);
+            }
+            str += '\n';
+        }
+        std::ofstream edges_file(prefix + "edges.csv", std::ios::binary);
+        return static_cast<bool>(edges_file.write(str.data(), str.size()));
+    }
+}
+
+/// Generate a synthetic network in node data and edge data format of arma-flow.
+int main(int argc, char** argv)
+{
+    janus::ArgParser arg_parser(
+        "Generates a synthetic power network for arma-flow.\n"
+        "usage: grid-gen [--version] [-h | --help] [-o <output_file_prefix>] [-n <num_nodes>]\n"
+        "                [--topology <mesh | radial>] [--pv <pv_ratio>] [--density <extra_edges_per_node>]\n"
+        "                [--transformers <transformer_ratio>] [--xd] [--seed <seed>]",
+        "grid-gen version 0.0.1");
+    arg_parser.newString("o", "");
+    arg_parser.newInt("n", 1000);
+    arg_parser.newString("topology", "mesh");
+    arg_parser.newDouble("pv", 0.1);
+    arg_parser.newDouble("density", 0.4);
+    arg_parser.newDouble("transformers", 0);
+    arg_parser.newFlag("xd");
+    arg_parser.newInt("seed", 1);
+    arg_parser.parse(argc, argv);
+
+    grid_options opts;
+    const auto num_nodes = arg_parser.getInt("n");
+    const auto topology = arg_parser.getString("topology");
+    opts.pv_ratio = arg_parser.getDouble("pv");
+    opts.density = arg_parser.getDouble("density");
+    // Transformers with off-nominal ratio are rare inside radial feeders.
+    opts.transformer_ratio = arg_parser.found("transformers") ? arg_parser.getDouble("transformers") :
+        topology == "mesh" ? 0.05 : 0;
+    opts.generator_admittance = arg_parser.getFlag("xd");
+    if (num_nodes < 2 || (topology != "mesh" && topology != "radial") ||
+        opts.pv_ratio < 0 || opts.pv_ratio > 1 || opts.density < 0 ||
+        opts.transformer_ratio < 0 || opts.transformer_ratio > 1) {
+        arg_parser.exitHelp();
+    }
+    opts.num_nodes = num_nodes;
+    opts.meshed = topology == "mesh";
+
+    std::mt19937_64 rng(arg_parser.getInt("seed"));
+    std::vector<grid_node> nodes;
+    std::vector<grid_edge> edges;
+    generate(opts, rng, nodes, edges);
+    if (!write(arg_parser.getString("o"), opts, nodes, edges)) {
+        std::cout << "Error: Failed to write to file." << std::endl;
+        return 1;
+    }
+    std::cout << "Generated " << nodes.size() << " nodes and " << edges.size() << " edges." << std::endl;
+}
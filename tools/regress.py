@@ -0,0 +1,394 @@
+#!/usr/bin/env python3
+#
+# arma-flow/tools/regress.py
+#
+# Checks that results of arma-flow agree across options which should not change them:
+# methods, orderings, mixed precision, number of threads, kernel instruction set, CSV input
+# versus binary case file, and CLI versus requests over socket (--serve).
+# Writes a summary line for each check, and exits with status 1 if any check fails.
+#
+# Fixtures are the example networks, and a synthetic meshed network generated by grid-gen,
+# which is large enough for evaluation to be split among threads.
+#
+# usage: regress.py
+#
+# Environment variables:
+#   ARMA_FLOW       Path to arma-flow (defaults to ./arma-flow)
+#   GRID_GEN        Path to grid-gen (defaults to ./grid-gen)
+#   REGRESS_DIR     Directory of generated fixtures and results (defaults to regress-results)
+#   REGRESS_NODES   Number of nodes of the synthetic network (defaults to 20000)
+#   REGRESS_THREADS Number of threads compared against a single thread (defaults to 4)
+#
+
+import os
+import signal
+import socket
+import struct
+import subprocess
+import sys
+import time
+
+ARMA_FLOW = os.environ.get('ARMA_FLOW', './arma-flow')
+GRID_GEN = os.environ.get('GRID_GEN', './grid-gen')
+REGRESS_DIR = os.environ.get('REGRESS_DIR', 'regress-results')
+REGRESS_NODES = os.environ.get('REGRESS_NODES', '20000')
+REGRESS_THREADS = os.environ.get('REGRESS_THREADS', '4')
+
+IEEE_39 = 'examples/New-England-10-gen-39-nodes/'
+IEEE_9 = 'examples/3-gen-9-nodes/'
+
+# Converged to 1e-10, while results are written with 6 decimal places.
+ACCURACY = ['-a', '1e-10', '-i', '100']
+TOLERANCE = 1e-5
+
+# Request types and response status of --serve.
+REQ_BASE, REQ_INJECTIONS, REQ_FAULT, REQ_OUTAGE = range(4)
+STATUS_OK, STATUS_NOT_CONVERGED, STATUS_ISLANDING, STATUS_BAD_REQUEST = range(4)
+
+failures = []
+
+
+def check(name, ok, detail=''):
+    print('%-64s %s%s' % (name, 'ok' if ok else 'FAILED', ' (' + detail + ')' if detail else ''))
+    if not ok:
+        failures.append(name)
+
+
+def run(prefix, args, env=None):
+    """Run arma-flow with output prefix. Returns whether it succeeded."""
+    with open(prefix + 'log.txt', 'w') as log:
+        retval = subprocess.call([ARMA_FLOW, '-o', prefix] + args, stdout=log, stderr=subprocess.STDOUT,
+                                 env=dict(os.environ, **(env or {})))
+    return retval == 0
+
+
+def read_csv(path):
+    """Read CSV file written by arma-flow (with header line) as rows of floats."""
+    with open(path) as file:
+        next(file)
+        return [[float(val) for val in line.split(',')] for line in file if line.strip()]
+
+
+def max_deviation(rows1, rows2):
+    if len(rows1) != len(rows2) or any(len(r1) != len(r2) for r1, r2 in zip(rows1, rows2)):
+        return float('inf')
+    return max((abs(v1 - v2) for r1, r2 in zip(rows1, rows2) for v1, v2 in zip(r1, r2)), default=0.0)
+
+
+def compare(name, rows1, rows2, tolerance=TOLERANCE):
+    deviation = max_deviation(rows1, rows2)
+    check(name, deviation <= tolerance, 'max deviation %g' % deviation)
+
+
+def compare_files(name, path1, path2, tolerance=TOLERANCE):
+    if not os.path.isfile(path1) or not os.path.isfile(path2):
+        check(name, False, 'missing output')
+        return
+    compare(name, read_csv(path1), read_csv(path2), tolerance)
+
+
+def same_files(name, path1, path2):
+    """Results which should not depend on the option at all are compared byte by byte."""
+    if not os.path.isfile(path1) or not os.path.isfile(path2):
+        check(name, False, 'missing output')
+        return
+    with open(path1, 'rb') as file1, open(path2, 'rb') as file2:
+        check(name, file1.read() == file2.read())
+
+
+class client:
+    """Client of arma-flow running with --serve."""
+
+    def __init__(self, prefix, args):
+        self.path = os.path.abspath(prefix + 'socket')
+        if os.path.exists(self.path):
+            os.unlink(self.path)
+        self.log = open(prefix + 'log.txt', 'w')
+        self.proc = subprocess.Popen([ARMA_FLOW, '-o', prefix, '--serve', self.path] + args,
+                                     stdout=self.log, stderr=subprocess.STDOUT)
+        self.sock = None
+        for _ in range(600):
+            if self.proc.poll() is not None:
+                break
+            try:
+                sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+                sock.connect(self.path)
+                self.sock = sock
+                break
+            except OSError:
+                sock.close()
+                time.sleep(0.05)
+
+    def close(self):
+        if self.sock:
+            self.sock.close()
+        if self.proc.poll() is None:
+            self.proc.send_signal(signal.SIGTERM)
+            try:
+                self.proc.wait(10)
+            except subprocess.TimeoutExpired:
+                self.proc.kill()
+                self.proc.wait()
+        self.log.close()
+
+    def recv_all(self, size):
+        data = b''
+        while len(data) < size:
+            chunk = self.sock.recv(size - len(data))
+            if not chunk:
+                raise OSError('connection closed')
+            data += chunk
+        return data
+
+    def request(self, req_type, payload=b''):
+        """Send a request. Returns response status and payload."""
+        self.sock.sendall(struct.pack('=II', req_type, len(payload)) + payload)
+        status, size = struct.unpack('=II', self.recv_all(8))
+        return status, self.recv_all(size)
+
+    @staticmethod
+    def doubles(payload, offset, count):
+        return list(struct.unpack_from('=%dd' % count, payload, offset))
+
+    @staticmethod
+    def result(payload):
+        """Parse result of power flow. Returns number of iterations and rows of V, theta, P, Q."""
+        n_iter, = struct.unpack_from('=I', payload)
+        values = client.doubles(payload, 8, (len(payload) - 8) // 8)
+        return n_iter, [values[i:i + 4] for i in range(0, len(values), 4)]
+
+
+def check_methods():
+    """Each method, ordering and precision converges to the same solution on CSV input."""
+    reference = REGRESS_DIR + '/ieee39-newton-colamd-'
+    run(reference, ['-n', IEEE_39 + 'nodes.csv', '-e', IEEE_39 + 'edges.csv', '-r', '--outputs', 'flow',
+                    '--method', 'newton', '--ordering', 'colamd'] + ACCURACY)
+    for method in ['newton', 'polar', 'fdlf']:
+        for ordering in ['colamd', 'md', 'rcm']:
+            for mixed in [False, True]:
+                if mixed and method == 'fdlf':
+                    continue
+                name = 'ieee39-%s-%s%s-' % (method, ordering, '-mixed' if mixed else '')
+                prefix = REGRESS_DIR + '/' + name
+                args = ['-n', IEEE_39 + 'nodes.csv', '-e', IEEE_39 + 'edges.csv', '-r', '--outputs', 'flow',
+                        '--method', method, '--ordering', ordering] + ACCURACY
+                if mixed:
+                    args.append('--mixed-precision')
+                if not run(prefix, args):
+                    check('flow ' + name[:-1], False, 'see ' + prefix + 'log.txt')
+                    continue
+                compare_files('flow ' + name[:-1], reference + 'flow.csv', prefix + 'flow.csv')
+
+
+def check_short_circuit():
+    """Node voltage after short circuit does not depend on ordering of node admittance matrix."""
+    reference = REGRESS_DIR + '/ieee9-fault-colamd-'
+    args = ['-n', IEEE_9 + 'nodes.csv', '-e', IEEE_9 + 'edges.csv', '-r', '-s', '4', '--outputs', 'fault'] + ACCURACY
+    run(reference, args + ['--ordering', 'colamd'])
+    for ordering in ['md', 'rcm']:
+        prefix = REGRESS_DIR + '/ieee9-fault-%s-' % ordering
+        if not run(prefix, args + ['--ordering', ordering]):
+            check('short circuit ordering ' + ordering, False, 'see ' + prefix + 'log.txt')
+            continue
+        compare_files('short circuit ordering ' + ordering, reference + 'short-circuit-voltage.csv',
+                      prefix + 'short-circuit-voltage.csv')
+
+
+def check_case_file():
+    """Binary case file gives the same result as CSV input, with and without node IDs."""
+    # Fixture with explicit node IDs (not contiguous), otherwise identical to the example.
+    nodes_with_id = REGRESS_DIR + '/ieee39-id-nodes.csv'
+    edges_with_id = REGRESS_DIR + '/ieee39-id-edges.csv'
+    with open(IEEE_39 + 'nodes.csv') as src, open(nodes_with_id, 'w') as dst:
+        dst.write('id,' + next(src))
+        for offset, line in enumerate(src, 1):
+            dst.write('%d,%s' % (offset * 10, line))
+    with open(IEEE_39 + 'edges.csv') as src, open(edges_with_id, 'w') as dst:
+        dst.write(next(src))
+        for line in src:
+            fields = line.split(',')
+            dst.write(','.join([str(int(fields[0]) * 10), str(int(fields[1]) * 10)] + fields[2:]))
+    reference = REGRESS_DIR + '/ieee39-newton-colamd-flow.csv'
+    for name, inputs in [('ieee39-case', ['-n', IEEE_39 + 'nodes.csv', '-e', IEEE_39 + 'edges.csv', '-r']),
+                         ('ieee39-id-case', ['-n', nodes_with_id, '-e', edges_with_id, '-r', '--node-id'])]:
+        prefix = REGRESS_DIR + '/' + name + '-'
+        case_file = prefix + 'case.bin'
+        if not run(prefix + 'convert-', inputs + ['--convert', case_file]):
+            check('convert ' + name, False, 'see ' + prefix + 'convert-log.txt')
+            continue
+        csv_ok = run(prefix + 'csv-', inputs + ['--outputs', 'flow'] + ACCURACY)
+        case_ok = run(prefix, ['--case', case_file, '--outputs', 'flow'] + ACCURACY)
+        if not csv_ok or not case_ok:
+            check('case file ' + name, False, 'see ' + prefix + '*log.txt')
+            continue
+        compare_files('csv input ' + name, reference, prefix + 'csv-flow.csv')
+        same_files('case file ' + name, prefix + 'csv-flow.csv', prefix + 'flow.csv')
+
+
+def check_threads():
+    """Results do not depend on number of threads or kernel instruction set."""
+    network = REGRESS_DIR + '/mesh-%s-' % REGRESS_NODES
+    if not os.path.isfile(network + 'nodes.csv') or not os.path.isfile(network + 'edges.csv'):
+        if subprocess.call([GRID_GEN, '-n', REGRESS_NODES, '--topology', 'mesh', '--xd', '-o', network],
+                           stdout=subprocess.DEVNULL) != 0:
+            check('generate ' + network, False)
+            return
+    inputs = ['-n', network + 'nodes.csv', '-e', network + 'edges.csv', '-r']
+    for method in ['newton', 'polar', 'fdlf']:
+        single = network + '%s-threads-1-' % method
+        multiple = network + '%s-threads-%s-' % (method, REGRESS_THREADS)
+        scalar = network + '%s-scalar-' % method
+        args = inputs + ['--outputs', 'flow', '--method', method] + ACCURACY
+        # Short circuit calculation is enabled only because generator admittance is given.
+        args += ['-s', '1']
+        if not run(single, args + ['--threads', '1']) or not run(multiple, args + ['--threads', REGRESS_THREADS]):
+            check('threads ' + method, False, 'see ' + network + method + '-threads-*log.txt')
+            continue
+        same_files('threads %s 1 vs %s' % (method, REGRESS_THREADS), single + 'flow.csv', multiple + 'flow.csv')
+        if not run(scalar, args + ['--threads', REGRESS_THREADS], {'ARMA_FLOW_KERNEL': 'scalar'}):
+            check('scalar kernel ' + method, False, 'see ' + scalar + 'log.txt')
+            continue
+        compare_files('scalar kernel ' + method, multiple + 'flow.csv', scalar + 'flow.csv')
+    # Short circuit sweep is calculated in blocks, in parallel, and written in order.
+    ids = ','.join(str(offset) for offset in range(1, 101))
+    args = inputs + ['--outputs', 'fault', '-s', ids] + ACCURACY
+    single = network + 'sweep-threads-1-'
+    multiple = network + 'sweep-threads-%s-' % REGRESS_THREADS
+    one = network + 'fault-7-'
+    if not run(single, args + ['--threads', '1']) or not run(multiple, args + ['--threads', REGRESS_THREADS]) \
+            or not run(one, inputs + ['--outputs', 'fault', '-s', '7'] + ACCURACY):
+        check('short circuit sweep', False, 'see ' + network + '*log.txt')
+        return
+    same_files('short circuit sweep 1 vs %s threads' % REGRESS_THREADS,
+               single + 'short-circuit-sweep.csv', multiple + 'short-circuit-sweep.csv')
+    row = [r for r in read_csv(multiple + 'short-circuit-sweep.csv') if r[0] == 7]
+    u_f = read_csv(one + 'short-circuit-voltage.csv')
+    swept = [row[0][5 + 2 * i:7 + 2 * i] for i in range(len(u_f))] if len(row) == 1 else []
+    compare('short circuit sweep vs single fault', u_f, swept)
+
+
+def injection_records(nodes):
+    """Injections payload of all nodes, from rows of node data (without node ID)."""
+    return b''.join(struct.pack('=II4d', id, 0, *row[:4]) for id, row in enumerate(nodes, 1))
+
+
+def check_server(method):
+    """Requests over socket give the same result as running CLI on the same data."""
+    inputs = ['-n', IEEE_39 + 'nodes.csv', '-e', IEEE_39 + 'edges.csv', '-r']
+    prefix = REGRESS_DIR + '/ieee39-serve-%s-' % method
+    srv = client(prefix, inputs + ['--outputs', 'flow', '--method', method] + ACCURACY)
+    try:
+        if not srv.sock:
+            check('serve ' + method, False, 'see ' + prefix + 'log.txt')
+            return
+        # Base case.
+        status, payload = srv.request(REQ_BASE)
+        check('serve %s base status' % method, status == STATUS_OK, 'status %d' % status)
+        if status == STATUS_OK:
+            compare('serve %s base' % method, read_csv(REGRESS_DIR + '/ieee39-newton-colamd-flow.csv'),
+                    client.result(payload)[1])
+        # New injections (loads scaled by 1.1), against CLI on modified node data file.
+        nodes = read_csv(IEEE_39 + 'nodes.csv')
+        for row in nodes:
+            row[2] *= 1.1
+            row[3] *= 1.1
+        modified = prefix + 'nodes.csv'
+        with open(modified, 'w') as file:
+            file.write('U,Generator,P,Q,type\n')
+            for row in nodes:
+                file.write(','.join(repr(val) for val in row[:4]) + ',%d\n' % row[4])
+        cli = prefix + 'injections-'
+        if not run(cli, ['-n', modified, '-e', IEEE_39 + 'edges.csv', '-r', '--outputs', 'flow',
+                         '--method', method] + ACCURACY):
+            check('serve %s injections' % method, False, 'see ' + cli + 'log.txt')
+        else:
+            for attempt in range(2):
+                status, payload = srv.request(REQ_INJECTIONS, injection_records(nodes))
+                name = 'serve %s injections (request %d)' % (method, attempt + 1)
+                check(name + ' status', status == STATUS_OK,
+                      'status %d' % status + (': ' + payload.decode(errors='replace')
+                                              if status == STATUS_BAD_REQUEST else ''))
+                if status == STATUS_OK:
+                    compare(name, read_csv(cli + 'flow.csv'), client.result(payload)[1])
+        # Edge outages, against N-1 contingency analysis.
+        cli = prefix + 'contingency-'
+        if not run(cli, inputs + ['--outputs', 'flow', '--method', method, '--contingency', 'n-1'] + ACCURACY):
+            check('serve %s outage' % method, False, 'see ' + cli + 'log.txt')
+            return
+        mismatches = []
+        for report in read_csv(cli + 'contingency.csv'):
+            edge = int(report[0])
+            status, payload = srv.request(REQ_OUTAGE, struct.pack('=II', edge, 0))
+            if status != int(report[3]):
+                mismatches.append('edge %d status %d vs %d' % (edge, status, report[3]))
+            elif status == STATUS_OK:
+                voltages = [row[0] for row in client.result(payload)[1]]
+                if abs(min(voltages) - report[7]) > TOLERANCE or abs(max(voltages) - report[9]) > TOLERANCE:
+                    mismatches.append('edge %d voltage' % edge)
+        check('serve %s outage vs contingency' % method, not mismatches, ', '.join(mismatches[:3]))
+    except OSError as e:
+        check('serve ' + method, False, str(e))
+    finally:
+        srv.close()
+
+
+def check_server_path():
+    """Serving never replaces a file at the socket path which is not a socket."""
+    prefix = REGRESS_DIR + '/ieee39-serve-path-'
+    path = prefix + 'regular-file'
+    with open(path, 'w') as file:
+        file.write('not a socket\n')
+    with open(prefix + 'log.txt', 'w') as log:
+        proc = subprocess.Popen([ARMA_FLOW, '-o', prefix, '--serve', os.path.abspath(path), '-n',
+                                 IEEE_39 + 'nodes.csv', '-e', IEEE_39 + 'edges.csv', '-r', '--outputs', 'flow'],
+                                stdout=log, stderr=subprocess.STDOUT)
+        try:
+            failed = proc.wait(30) != 0
+        except subprocess.TimeoutExpired:
+            proc.kill()
+            proc.wait()
+            failed = False
+    check('serve refuses regular file at socket path', failed and os.path.isfile(path))
+
+
+def check_server_fault():
+    """Fault request gives the same node voltage as CLI."""
+    inputs = ['-n', IEEE_9 + 'nodes.csv', '-e', IEEE_9 + 'edges.csv', '-r', '-s', '4', '--outputs', 'fault']
+    prefix = REGRESS_DIR + '/ieee9-serve-fault-'
+    srv = client(prefix, inputs + ACCURACY)
+    try:
+        if not srv.sock:
+            check('serve fault', False, 'see ' + prefix + 'log.txt')
+            return
+        u_f = read_csv(REGRESS_DIR + '/ieee9-fault-colamd-short-circuit-voltage.csv')
+        for id in [4, 7, 4]:
+            status, payload = srv.request(REQ_FAULT, struct.pack('=II2d', id, 0, 0.0, 0.0))
+            check('serve fault node %d status' % id, status == STATUS_OK, 'status %d' % status)
+            if status == STATUS_OK and id == 4:
+                values = client.doubles(payload, 16, 2 * len(u_f))
+                compare('serve fault node 4', u_f, [values[i:i + 2] for i in range(0, len(values), 2)])
+    except OSError as e:
+        check('serve fault', False, str(e))
+    finally:
+        srv.close()
+
+
+def main():
+    os.makedirs(REGRESS_DIR, exist_ok=True)
+    check_methods()
+    check_short_circuit()
+    check_case_file()
+    check_threads()
+    for method in ['newton', 'fdlf']:
+        check_server(method)
+    check_server_path()
+    check_server_fault()
+    if failures:
+        print('\n%d check(s) failed.' % len(failures))
+        return 1
+    print('\nAll checks passed.')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())